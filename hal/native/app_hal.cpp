@@ -0,0 +1,74 @@
+#include "app_hal.h"
+#include "io.h"
+
+
+namespace hal {
+
+static uint32_t timestamp_ms = 0;
+static fix16_t power = 0;
+
+// Fake DMA buffer, the same layout as on MCU, and simulated ADC state
+static uint16_t ADCBuffer[ADC_FETCH_PER_TICK * ADC_CHANNELS_COUNT * 2];
+static uint32_t adc_conversion = 0;
+static uint8_t adc_half = 0;
+
+void setup()
+{
+    timestamp_ms = 0;
+    power = 0;
+    adc_conversion = 0;
+    adc_half = 0;
+}
+
+void adc_simulate_half(Io &io, adc_source_t source)
+{
+    uint32_t offset = adc_half * ADC_FETCH_PER_TICK * ADC_CHANNELS_COUNT;
+
+    for (uint32_t i = 0; i < ADC_FETCH_PER_TICK; i++)
+    {
+        for (uint8_t channel = 0; channel < ADC_CHANNELS_COUNT; channel++)
+        {
+            // Hardware oversampling truncates average (right shift)
+            uint32_t sum = 0;
+            for (uint32_t k = 0; k < ADC_HW_OVERSAMPLE; k++) sum += source(adc_conversion + k, channel);
+
+            ADCBuffer[offset + i * ADC_CHANNELS_COUNT + channel] = uint16_t(sum / ADC_HW_OVERSAMPLE);
+        }
+
+        adc_conversion += ADC_HW_OVERSAMPLE;
+    }
+
+    io.consume(
+        { &ADCBuffer[offset + ADC_CURRENT_RANK], ADC_CHANNELS_COUNT },
+        { &ADCBuffer[offset + ADC_KNOB_RANK], ADC_CHANNELS_COUNT }
+    );
+
+    adc_half ^= 1;
+}
+
+void set_power(fix16_t duty_cycle)
+{
+    // Clamp value
+    fix16_t val = duty_cycle;
+    if (val > fix16_one) val = fix16_one;
+    if (val < 0) val = 0;
+
+    power = val;
+}
+
+fix16_t get_power()
+{
+    return power;
+}
+
+uint32_t get_timestamp()
+{
+    return timestamp_ms;
+}
+
+void set_timestamp(uint32_t ms)
+{
+    timestamp_ms = ms;
+}
+
+}
@@ -0,0 +1,46 @@
+#ifndef __APP_HAL__
+#define __APP_HAL__
+
+// Host HAL, used by native tests to replay recorded data
+// and simulate firmware modules without hardware.
+
+#include <stdint.h>
+#include "libfixmath/fix16.h"
+
+#include "adc_profile.h"
+
+// Match doc/data recordings. Output rate stays SAMPLING_RATE for all ADC
+// profiles, simulated ADC runs ADC_HW_OVERSAMPLE * ADC_OVERSAMPLE times
+// faster.
+#define SAMPLING_RATE 15625
+
+
+#define GET_TIMESTAMP() hal::get_timestamp()
+
+
+class Io;
+
+namespace hal {
+
+void setup();
+void set_power(fix16_t duty_cycle);
+
+// Fake time, controlled by tests
+uint32_t get_timestamp();
+void set_timestamp(uint32_t ms);
+
+// Last value, passed to set_power()
+fix16_t get_power();
+
+// Simulated ADC input: channel value (12 bits) at given conversion. ADC
+// makes SAMPLING_RATE * ADC_OVERSAMPLE * ADC_HW_OVERSAMPLE conversions
+// per second. Channel is DMA rank (ADC_CURRENT_RANK, ADC_KNOB_RANK).
+typedef uint16_t (*adc_source_t)(uint32_t conversion, uint8_t channel);
+
+// Fill the next half of fake DMA buffer (with hardware oversampling, if
+// enabled), and pass it to io, like DMA interrupt does on MCU.
+void adc_simulate_half(Io &io, adc_source_t source);
+
+} // namespace
+
+#endif
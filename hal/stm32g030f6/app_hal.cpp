@@ -3,6 +3,7 @@
 #include "dma.h"
 #include "tim.h"
 #include "gpio.h"
+#include "stm32g0xx_ll_adc.h"
 
 #include "app_hal.h"
 #include "app.h"
@@ -19,32 +20,25 @@ namespace hal {
 
 static volatile uint16_t ADCBuffer[ADC_FETCH_PER_TICK * ADC_CHANNELS_COUNT * 2];
 
-// Resorted adc data for convenient use
-static uint16_t adc_current_buf[ADC_FETCH_PER_TICK];
-static uint16_t adc_knob_buf[ADC_FETCH_PER_TICK];
-
-// Split raw ADC data by separate buffers
-static void adc_raw_data_load(uint32_t adc_data_offset)
+// Pass completed half of DMA buffer to io, as views of channels (no copy)
+static void adc_half_consume(uint32_t adc_data_offset)
 {
-    for (int sample = 0; sample < ADC_FETCH_PER_TICK; sample++)
-    {
-        adc_current_buf[sample] = ADCBuffer[adc_data_offset++];
-        adc_knob_buf[sample] = ADCBuffer[adc_data_offset++];
-    }
+    io.consume(
+        { &ADCBuffer[adc_data_offset + ADC_CURRENT_RANK], ADC_CHANNELS_COUNT },
+        { &ADCBuffer[adc_data_offset + ADC_KNOB_RANK], ADC_CHANNELS_COUNT }
+    );
 }
 
 void on_adc_half_transfer_done(ADC_HandleTypeDef* AdcHandle)
 {
     (void)(AdcHandle);
-    adc_raw_data_load(0);
-    io.consume(adc_current_buf, adc_knob_buf);
+    adc_half_consume(0);
 }
 
 void on_adc_transfer_done(ADC_HandleTypeDef* AdcHandle)
 {
     (void)(AdcHandle);
-    adc_raw_data_load(ADC_FETCH_PER_TICK * ADC_CHANNELS_COUNT);
-    io.consume(adc_current_buf, adc_knob_buf);
+    adc_half_consume(ADC_FETCH_PER_TICK * ADC_CHANNELS_COUNT);
 }
 
 // PWM period
@@ -70,6 +64,26 @@ void set_power(fix16_t duty_cycle)
     );
 }
 
+// Apply ADC_PROFILE over CubeMX config (RAW profile). ADC is not enabled
+// yet, so sampling time & oversampling are written to registers directly,
+// without second HAL_ADC_Init() - channels & sequencer ranks stay as is.
+static void adc_profile_init()
+{
+#if ADC_PROFILE == ADC_PROFILE_HW_OVERSAMPLING
+    // Short sampling for current, and a bit longer one for knob pot (higher
+    // impedance, ADC_CHANNEL_1). Oversampling applies to every channel of
+    // sequence.
+    LL_ADC_SetSamplingTimeCommonChannels(ADC1, LL_ADC_SAMPLINGTIME_COMMON_1, LL_ADC_SAMPLINGTIME_7CYCLES_5);
+    LL_ADC_SetSamplingTimeCommonChannels(ADC1, LL_ADC_SAMPLINGTIME_COMMON_2, LL_ADC_SAMPLINGTIME_12CYCLES_5);
+    LL_ADC_SetChannelSamplingTime(ADC1, LL_ADC_CHANNEL_1, LL_ADC_SAMPLINGTIME_COMMON_2);
+    LL_ADC_ConfigOverSamplingRatioShift(ADC1, LL_ADC_OVS_RATIO_8, LL_ADC_OVS_SHIFT_RIGHT_3);
+    LL_ADC_SetOverSamplingDiscont(ADC1, LL_ADC_OVS_REG_CONT);
+    LL_ADC_SetOverSamplingScope(ADC1, LL_ADC_OVS_GRP_REGULAR_CONTINUED);
+#elif ADC_PROFILE == ADC_PROFILE_SW_OVERSAMPLING
+    LL_ADC_SetSamplingTimeCommonChannels(ADC1, LL_ADC_SAMPLINGTIME_COMMON_1, LL_ADC_SAMPLINGTIME_39CYCLES_5);
+#endif
+}
+
 // HW init
 void setup(void)
 {
@@ -79,6 +93,7 @@ void setup(void)
     MX_GPIO_Init();
     MX_DMA_Init();
     MX_ADC1_Init();
+    adc_profile_init();
     MX_TIM1_Init();
     MX_TIM14_Init();
 
@@ -5,14 +5,16 @@
 #include "libfixmath/fix16.h"
 #include "stm32g0xx_hal.h"
 
+#include "adc_profile.h"
+
+// Sample rate per ADC profile, scaled from measured RAW one.
+#if ADC_PROFILE == ADC_PROFILE_HW_OVERSAMPLING
+#define SAMPLING_RATE 16764
+#elif ADC_PROFILE == ADC_PROFILE_SW_OVERSAMPLING
+#define SAMPLING_RATE 14507
+#else
 #define SAMPLING_RATE 17442
-
-// Oversampling ratio. Used to define buffer sizes
-#define ADC_FETCH_PER_TICK 1
-
-// How many channels are sampled "in parallel".
-// Used to define global DMA buffer size.
-#define ADC_CHANNELS_COUNT 2
+#endif
 
 
 #define GET_TIMESTAMP() HAL_GetTick()
@@ -22,6 +22,9 @@ typedef struct {
 // Readability macros
 #define FFT_QCOS(K, SH) sinetable[(1 << SINE_BITS) - (K << SH)]
 #define FFT_QSIN(K, SH) sinetable[K << SH]
+// The same for custom sine table T with 2^TB + 1 points
+#define FFT_TQCOS(T, TB, K, SH) T[(1 << (TB)) - ((K) << (SH))]
+#define FFT_TQSIN(T, K, SH) T[(K) << (SH)]
 
 #if !((defined FFT_DIT) | (defined FFT_DIF))
 #error "Must define FFT_DIT or FFT_DIF"
@@ -77,87 +80,178 @@ typedef struct {
 
 /* == FORWARD AND INVERSE FFT ===================================== */
 
-// Forward FFT transform
-// Permutation must be performed prior to (DIT)/after (DIF) call
-__INLINE void fft_forward(fft_complex_t data[], unsigned bits) {
-  unsigned size = 1 << bits;
+// Single pass of forward FFT transform (all butterflies of one stride)
+// Allows to split transform into small steps. Sine table (first quadrant,
+// 2^sine_bits + 1 points) can be provided by caller.
+__INLINE void fft_forward_pass(fft_complex_t data[], unsigned size, unsigned stride, unsigned shift,
+                               const int32_t sine[], unsigned sine_bits) {
+  // Twiddle and combine for k = 0, having trivial (0 and 1) twiddle factors
+  for(unsigned a = 0; a < size; a += stride) {
+    unsigned b = a + (stride >> 1);
+/*
+    FFT_DECLC(A, data[a]); FFT_DECLC(B, data[b]);
+    // # Radix-2 DIT/DIF trivial butterfly #
+    FFT_ASSGN(data[a], FFT_D2(FFT_ADD(FFT(A,r), FFT(B,r))), FFT_D2(FFT_ADD(FFT(A,i), FFT(B,i))));
+    FFT_ASSGN(data[b], FFT_D2(FFT_SUB(FFT(A,r), FFT(B,r))), FFT_D2(FFT_SUB(FFT(A,i), FFT(B,i))));
+*/
+    // Special case: GCC optimizes ARMCC style better here
+    fft_complex_t A = data[a], B = data[b];
+    // # Radix-2 DIT/DIF trivial butterfly #
+    data[a] = (fft_complex_t){ .r = FFT_D2(FFT_A(A.r, B.r)), .i = FFT_D2(FFT_A(A.i, B.i)) };
+    data[b] = (fft_complex_t){ .r = FFT_D2(FFT_S(A.r, B.r)), .i = FFT_D2(FFT_S(A.i, B.i)) };
+  }
+  if(!(stride & 2)) {
+    for(unsigned a = (stride >> 2); a < (stride >> 2) + size; a += stride) {
+      unsigned b = a + (stride >> 1);
+      FFT_DECLC(A, data[a]); FFT_DECLC(B, data[b]);
 #ifdef FFT_DIT
-  unsigned shift = SINE_BITS + 1;
-  for(unsigned stride = 2 ; stride <= size; stride <<= 1, shift--) {
+      // # Radix-2 DIT trivial butterfly #
+      FFT_ASSGN(data[a], FFT_D2(FFT_A(FFT(A,r), FFT(B,i))), FFT_D2(FFT_S(FFT(A,i), FFT(B,r))));
+      FFT_ASSGN(data[b], FFT_D2(FFT_S(FFT(A,r), FFT(B,i))), FFT_D2(FFT_A(FFT(A,i), FFT(B,r))));
 #else//FFT_DIF
-  unsigned shift = SINE_BITS - (bits - 2);
-  for(unsigned stride = size; stride >= 2; stride >>= 1, shift++) {
+      // # Radix-2 DIF trivial butterfly #
+      FFT_ASSGN(data[a], FFT_D2(FFT_A(FFT(A,r), FFT(B,r))), FFT_D2(FFT_A(FFT(A,i), FFT(B,i))));
+      FFT_ASSGN(data[b], FFT_D2(FFT_S(FFT(A,i), FFT(B,i))), FFT_D2(FFT_S(FFT(B,r), FFT(A,r))));
 #endif
-    // Twiddle and combine for k = 0, having trivial (0 and 1) twiddle factors
-    for(unsigned a = 0; a < size; a += stride) {
-      unsigned b = a + (stride >> 1);
-/*
-      FFT_DECLC(A, data[a]); FFT_DECLC(B, data[b]);
-      // # Radix-2 DIT/DIF trivial butterfly #
-      FFT_ASSGN(data[a], FFT_D2(FFT_ADD(FFT(A,r), FFT(B,r))), FFT_D2(FFT_ADD(FFT(A,i), FFT(B,i))));
-      FFT_ASSGN(data[b], FFT_D2(FFT_SUB(FFT(A,r), FFT(B,r))), FFT_D2(FFT_SUB(FFT(A,i), FFT(B,i))));
-*/
-      // Special case: GCC optimizes ARMCC style better here
-      fft_complex_t A = data[a], B = data[b];
-      // # Radix-2 DIT/DIF trivial butterfly #
-      data[a] = (fft_complex_t){ .r = FFT_D2(FFT_A(A.r, B.r)), .i = FFT_D2(FFT_A(A.i, B.i)) };
-      data[b] = (fft_complex_t){ .r = FFT_D2(FFT_S(A.r, B.r)), .i = FFT_D2(FFT_S(A.i, B.i)) };
     }
-    if(!(stride & 2)) {
-      for(unsigned a = (stride >> 2); a < (stride >> 2) + size; a += stride) {
-        unsigned b = a + (stride >> 1);
+  }
+  // Twiddle and combine
+  for(unsigned k = 1; k < (stride >> 2); k++) {
+    FFT_DECLR(W, FFT_TQCOS(sine, sine_bits, k, shift), FFT_TQSIN(sine, k, shift));
+    for(unsigned a = k, b; a < size; a += (stride >> 2) + (stride >> 1)) {
+      b = a + (stride >> 1);
+      { // These two blocks prevent the compiler from confusing...
         FFT_DECLC(A, data[a]); FFT_DECLC(B, data[b]);
 #ifdef FFT_DIT
-        // # Radix-2 DIT trivial butterfly #
-        FFT_ASSGN(data[a], FFT_D2(FFT_A(FFT(A,r), FFT(B,i))), FFT_D2(FFT_S(FFT(A,i), FFT(B,r))));
-        FFT_ASSGN(data[b], FFT_D2(FFT_S(FFT(A,r), FFT(B,i))), FFT_D2(FFT_A(FFT(A,i), FFT(B,r))));
+        // # Radix-2 DIT butterfly #
+        FFT_DECLR(BW, FFT_MA(FFT(B,i), FFT(W,i), FFT_M(FFT(B,r), FFT(W,r))),
+                      FFT_MS(FFT(B,r), FFT(W,i), FFT_M(FFT(B,i), FFT(W,r))));
+        FFT_ASSGN(data[a], FFT_A(FFT_D2(FFT(A,r)), FFT(BW,r)), FFT_A(FFT_D2(FFT(A,i)), FFT(BW,i)));
+        FFT_ASSGN(data[b], FFT_S(FFT_D2(FFT(A,r)), FFT(BW,r)), FFT_S(FFT_D2(FFT(A,i)), FFT(BW,i)));
 #else//FFT_DIF
-        // # Radix-2 DIF trivial butterfly #
+        // # Radix-2 DIF butterfly #
         FFT_ASSGN(data[a], FFT_D2(FFT_A(FFT(A,r), FFT(B,r))), FFT_D2(FFT_A(FFT(A,i), FFT(B,i))));
-        FFT_ASSGN(data[b], FFT_D2(FFT_S(FFT(A,i), FFT(B,i))), FFT_D2(FFT_S(FFT(B,r), FFT(A,r))));
+        FFT_DECLR(D, FFT_S(FFT(A,r), FFT(B,r)), FFT_S(FFT(A,i), FFT(B,i)));
+        FFT_ASSGN(data[b], FFT_MA(FFT(D,r), FFT(W,r), FFT_M(FFT(D,i), FFT(W,i))),
+                           FFT_MS(FFT(D,r), FFT(W,i), FFT_M(FFT(D,i), FFT(W,r))));
 #endif
       }
-    }
-    // Twiddle and combine
-    for(unsigned k = 1; k < (stride >> 2); k++) {
-      FFT_DECLR(W, FFT_QCOS(k, shift), FFT_QSIN(k, shift));
-      for(unsigned a = k, b; a < size; a += (stride >> 2) + (stride >> 1)) {
-        b = a + (stride >> 1);
-        { // These two blocks prevent the compiler from confusing...
-          FFT_DECLC(A, data[a]); FFT_DECLC(B, data[b]);
+      a += (stride >> 2); b += (stride >> 2);
+      { // ...register use resulting in more efficient code
+        FFT_DECLC(A, data[a]); FFT_DECLC(B, data[b]);
 #ifdef FFT_DIT
-          // # Radix-2 DIT butterfly #
-          FFT_DECLR(BW, FFT_MA(FFT(B,i), FFT(W,i), FFT_M(FFT(B,r), FFT(W,r))),
-                        FFT_MS(FFT(B,r), FFT(W,i), FFT_M(FFT(B,i), FFT(W,r))));
-          FFT_ASSGN(data[a], FFT_A(FFT_D2(FFT(A,r)), FFT(BW,r)), FFT_A(FFT_D2(FFT(A,i)), FFT(BW,i)));
-          FFT_ASSGN(data[b], FFT_S(FFT_D2(FFT(A,r)), FFT(BW,r)), FFT_S(FFT_D2(FFT(A,i)), FFT(BW,i)));
+        // # Radix-2 DIT butterfly #
+        FFT_DECLR(BW, FFT_MS(FFT(B,r), FFT(W,i), FFT_M(FFT(B,i), FFT(W,r))),
+                      FFT_MA(FFT(B,i), FFT(W,i), FFT_M(FFT(B,r), FFT(W,r))));
+        FFT_ASSGN(data[a], FFT_A(FFT_D2(FFT(A,r)), FFT(BW,r)), FFT_S(FFT_D2(FFT(A,i)), FFT(BW,i)));
+        FFT_ASSGN(data[b], FFT_S(FFT_D2(FFT(A,r)), FFT(BW,r)), FFT_A(FFT_D2(FFT(A,i)), FFT(BW,i)));
 #else//FFT_DIF
-          // # Radix-2 DIF butterfly #
-          FFT_ASSGN(data[a], FFT_D2(FFT_A(FFT(A,r), FFT(B,r))), FFT_D2(FFT_A(FFT(A,i), FFT(B,i))));
-          FFT_DECLR(D, FFT_S(FFT(A,r), FFT(B,r)), FFT_S(FFT(A,i), FFT(B,i)));
-          FFT_ASSGN(data[b], FFT_MA(FFT(D,r), FFT(W,r), FFT_M(FFT(D,i), FFT(W,i))),
-                             FFT_MS(FFT(D,r), FFT(W,i), FFT_M(FFT(D,i), FFT(W,r))));
+        // # Radix-2 DIF butterfly #
+        FFT_ASSGN(data[a], FFT_D2(FFT_A(FFT(A,r), FFT(B,r))), FFT_D2(FFT_A(FFT(A,i), FFT(B,i))));
+        FFT_DECLR(D, FFT_S(FFT(B,r), FFT(A,r)), FFT_S(FFT(B,i), FFT(A,i)));
+        FFT_ASSGN(data[b], FFT_MS(FFT(D,i), FFT(W,r), FFT_M(FFT(D,r), FFT(W,i))),
+                           FFT_MA(FFT(D,i), FFT(W,i), FFT_M(FFT(D,r), FFT(W,r))));
 #endif
-        }
-        a += (stride >> 2); b += (stride >> 2);
-        { // ...register use resulting in more efficient code
-          FFT_DECLC(A, data[a]); FFT_DECLC(B, data[b]);
+      }
+    }
+  }
+}
+
 #ifdef FFT_DIT
-          // # Radix-2 DIT butterfly #
-          FFT_DECLR(BW, FFT_MS(FFT(B,r), FFT(W,i), FFT_M(FFT(B,i), FFT(W,r))),
-                        FFT_MA(FFT(B,i), FFT(W,i), FFT_M(FFT(B,r), FFT(W,r))));
-          FFT_ASSGN(data[a], FFT_A(FFT_D2(FFT(A,r)), FFT(BW,r)), FFT_S(FFT_D2(FFT(A,i)), FFT(BW,i)));
-          FFT_ASSGN(data[b], FFT_S(FFT_D2(FFT(A,r)), FFT(BW,r)), FFT_A(FFT_D2(FFT(A,i)), FFT(BW,i)));
+// Twiddle factor for angle pos in [0..2PI), in table units (2^sine_bits
+// per PI/2). Sine table (first quadrant) is unfolded by symmetry.
+__INLINE void fft_twiddle(const int32_t sine[], unsigned sine_bits, unsigned pos, fft_t *c, fft_t *s) {
+  unsigned q = 1 << sine_bits;
+  unsigned r = pos & (q - 1);
+  switch((pos >> sine_bits) & 3) {
+    case 0:  *c =  sine[q - r]; *s =  sine[r];     break;
+    case 1:  *c = -sine[r];     *s =  sine[q - r]; break;
+    case 2:  *c = -sine[q - r]; *s = -sine[r];     break;
+    default: *c =  sine[r];     *s = -sine[q - r]; break;
+  }
+}
+
+// Two passes of forward DIT FFT (stride, stride * 2) in one sweep, with
+// radix-4 butterflies on radix-2 (bit reversed) input order. For points
+// a0..a3 at k, k + stride/2, k + stride, k + stride*3/2 of every
+// stride * 2 block, and w = W(stride * 2, k):
+//
+//   t1 = w^2 * a1, t2 = w * a2, t3 = w^3 * a3
+//   s0 = a0 + t1, s1 = a0 - t1, s2 = t2 + t3, s3 = t2 - t3
+//   c0 = s0 + s2, c1 = s1 - j*s3, c2 = s0 - s2, c3 = s1 + j*s3
+//
+// 3 complex multiplies per 4 points instead of 4, and half of memory
+// passes. Result is the same as of two radix-2 passes (scaled by 1/4), up
+// to rounding. `shift` is the one of radix-2 pass with `stride`. Plain C
+// over FFT_M* macros, so works on any target (64-bit multiply fallback
+// without SMMUL).
+__INLINE void fft_forward_pass_radix4(fft_complex_t data[], unsigned size, unsigned stride, unsigned shift,
+                                      const int32_t sine[], unsigned sine_bits) {
+  unsigned half = stride >> 1;
+  // k = 0, trivial twiddles
+  for(unsigned a = 0; a < size; a += (stride << 1)) {
+    FFT_DECLC(A0, data[a]);          FFT_DECLC(A1, data[a + half]);
+    FFT_DECLC(A2, data[a + stride]); FFT_DECLC(A3, data[a + stride + half]);
+    FFT_DECLR(S0, FFT_D2(FFT_A(FFT(A0,r), FFT(A1,r))), FFT_D2(FFT_A(FFT(A0,i), FFT(A1,i))));
+    FFT_DECLR(S1, FFT_D2(FFT_S(FFT(A0,r), FFT(A1,r))), FFT_D2(FFT_S(FFT(A0,i), FFT(A1,i))));
+    FFT_DECLR(S2, FFT_D2(FFT_A(FFT(A2,r), FFT(A3,r))), FFT_D2(FFT_A(FFT(A2,i), FFT(A3,i))));
+    FFT_DECLR(S3, FFT_D2(FFT_S(FFT(A2,r), FFT(A3,r))), FFT_D2(FFT_S(FFT(A2,i), FFT(A3,i))));
+    FFT_ASSGN(data[a],                  FFT_D2(FFT_A(FFT(S0,r), FFT(S2,r))), FFT_D2(FFT_A(FFT(S0,i), FFT(S2,i))));
+    FFT_ASSGN(data[a + stride],         FFT_D2(FFT_S(FFT(S0,r), FFT(S2,r))), FFT_D2(FFT_S(FFT(S0,i), FFT(S2,i))));
+    FFT_ASSGN(data[a + half],           FFT_D2(FFT_A(FFT(S1,r), FFT(S3,i))), FFT_D2(FFT_S(FFT(S1,i), FFT(S3,r))));
+    FFT_ASSGN(data[a + stride + half],  FFT_D2(FFT_S(FFT(S1,r), FFT(S3,i))), FFT_D2(FFT_A(FFT(S1,i), FFT(S3,r))));
+  }
+  // Twiddle and combine
+  for(unsigned k = 1; k < half; k++) {
+    unsigned pos = k << (shift - 1);
+    fft_t W1r, W1i, W2r, W2i, W3r, W3i;
+    fft_twiddle(sine, sine_bits, pos, &W1r, &W1i);
+    fft_twiddle(sine, sine_bits, pos * 2, &W2r, &W2i);
+    fft_twiddle(sine, sine_bits, pos * 3, &W3r, &W3i);
+    for(unsigned a = k; a < size; a += (stride << 1)) {
+      FFT_DECLC(A0, data[a]);          FFT_DECLC(A1, data[a + half]);
+      FFT_DECLC(A2, data[a + stride]); FFT_DECLC(A3, data[a + stride + half]);
+      // B * conj(W), halved by multiply
+      FFT_DECLR(T1, FFT_MA(FFT(A1,i), W2i, FFT_M(FFT(A1,r), W2r)), FFT_MS(FFT(A1,r), W2i, FFT_M(FFT(A1,i), W2r)));
+      FFT_DECLR(T2, FFT_MA(FFT(A2,i), W1i, FFT_M(FFT(A2,r), W1r)), FFT_MS(FFT(A2,r), W1i, FFT_M(FFT(A2,i), W1r)));
+      FFT_DECLR(T3, FFT_MA(FFT(A3,i), W3i, FFT_M(FFT(A3,r), W3r)), FFT_MS(FFT(A3,r), W3i, FFT_M(FFT(A3,i), W3r)));
+      FFT_DECLR(S0, FFT_A(FFT_D2(FFT(A0,r)), FFT(T1,r)), FFT_A(FFT_D2(FFT(A0,i)), FFT(T1,i)));
+      FFT_DECLR(S1, FFT_S(FFT_D2(FFT(A0,r)), FFT(T1,r)), FFT_S(FFT_D2(FFT(A0,i)), FFT(T1,i)));
+      FFT_DECLR(S2, FFT_A(FFT(T2,r), FFT(T3,r)), FFT_A(FFT(T2,i), FFT(T3,i)));
+      FFT_DECLR(S3, FFT_S(FFT(T2,r), FFT(T3,r)), FFT_S(FFT(T2,i), FFT(T3,i)));
+      FFT_ASSGN(data[a],                  FFT_D2(FFT_A(FFT(S0,r), FFT(S2,r))), FFT_D2(FFT_A(FFT(S0,i), FFT(S2,i))));
+      FFT_ASSGN(data[a + stride],         FFT_D2(FFT_S(FFT(S0,r), FFT(S2,r))), FFT_D2(FFT_S(FFT(S0,i), FFT(S2,i))));
+      FFT_ASSGN(data[a + half],           FFT_D2(FFT_A(FFT(S1,r), FFT(S3,i))), FFT_D2(FFT_S(FFT(S1,i), FFT(S3,r))));
+      FFT_ASSGN(data[a + stride + half],  FFT_D2(FFT_S(FFT(S1,r), FFT(S3,i))), FFT_D2(FFT_A(FFT(S1,i), FFT(S3,r))));
+    }
+  }
+}
+
+// Forward DIT FFT transform by radix-4 passes, the last one is radix-2
+// for odd bits. Permutation must be performed prior to call
+__INLINE void fft_forward_radix4(fft_complex_t data[], unsigned bits) {
+  unsigned size = 1 << bits;
+  unsigned shift = SINE_BITS + 1;
+  unsigned stride = 2;
+  for(; (stride << 1) <= size; stride <<= 2, shift -= 2) {
+    fft_forward_pass_radix4(data, size, stride, shift, sinetable, SINE_BITS);
+  }
+  if(stride <= size) fft_forward_pass(data, size, stride, shift, sinetable, SINE_BITS);
+}
+#endif
+
+// Forward FFT transform
+// Permutation must be performed prior to (DIT)/after (DIF) call
+__INLINE void fft_forward(fft_complex_t data[], unsigned bits) {
+  unsigned size = 1 << bits;
+#ifdef FFT_DIT
+  unsigned shift = SINE_BITS + 1;
+  for(unsigned stride = 2 ; stride <= size; stride <<= 1, shift--) {
 #else//FFT_DIF
-          // # Radix-2 DIF butterfly #
-          FFT_ASSGN(data[a], FFT_D2(FFT_A(FFT(A,r), FFT(B,r))), FFT_D2(FFT_A(FFT(A,i), FFT(B,i))));
-          FFT_DECLR(D, FFT_S(FFT(B,r), FFT(A,r)), FFT_S(FFT(B,i), FFT(A,i)));
-          FFT_ASSGN(data[b], FFT_MS(FFT(D,i), FFT(W,r), FFT_M(FFT(D,r), FFT(W,i))),
-                             FFT_MA(FFT(D,i), FFT(W,i), FFT_M(FFT(D,r), FFT(W,r))));
+  unsigned shift = SINE_BITS - (bits - 2);
+  for(unsigned stride = size; stride >= 2; stride >>= 1, shift++) {
 #endif
-        }
-      }
-    }
+    fft_forward_pass(data, size, stride, shift, sinetable, SINE_BITS);
   }
 }
 
@@ -251,9 +345,11 @@ __INLINE void fft_inverse(fft_complex_t data[], unsigned bits) {
 // Process complex data to produce real-only output
 // This allows us to output N*2 point of real data using a N point complex (I)FFT
 // Even/odd real data will be found in the real/imaginary parts of every output bin upon completion
-__INLINE void fft_convert(fft_complex_t data[], unsigned bits, bool permutated, bool invert) {
+// Sine table (first quadrant, 2^sine_bits + 1 points) is provided by caller
+__INLINE void fft_convert_table(fft_complex_t data[], unsigned bits, bool permutated, bool invert,
+                                const int32_t sine[], unsigned sine_bits) {
   unsigned size = 1 << --bits;
-  unsigned shift = SINE_BITS - bits++;
+  unsigned shift = sine_bits - bits++;
   unsigned n, z, nc, zc;
   fft_t rsum, rdif, isum, idif;
   fft_t itwiddled, rtwiddled;
@@ -265,7 +361,7 @@ __INLINE void fft_convert(fft_complex_t data[], unsigned bits, bool permutated,
     }
     rsum = data[n].r + data[z].r; isum = data[n].i + data[z].i;
     rdif = data[n].r - data[z].r; idif = data[n].i - data[z].i;
-    fft_t r =  FFT_QCOS(nc, shift); fft_t i = -FFT_QSIN(nc, shift);
+    fft_t r =  FFT_TQCOS(sine, sine_bits, nc, shift); fft_t i = -FFT_TQSIN(sine, nc, shift);
     if(invert) r = -r;
     rtwiddled = FFT_MA(r, isum, FFT_M(i, rdif)) << 1;
     itwiddled = FFT_MS(r, rdif, FFT_M(i, isum)) << 1;
@@ -277,6 +373,10 @@ __INLINE void fft_convert(fft_complex_t data[], unsigned bits, bool permutated,
   if(!invert) { data[0].r <<= 1; data[0].i <<= 1; }
 }
 
+__INLINE void fft_convert(fft_complex_t data[], unsigned bits, bool permutated, bool invert) {
+  fft_convert_table(data, bits, permutated, invert, sinetable, SINE_BITS);
+}
+
 // Perform bit-reversal permutation on data set
 // (Reverses address bits for all data points)
 __INLINE void fft_permutate(fft_complex_t data[], unsigned bits) {
@@ -0,0 +1,49 @@
+#ifndef __ADC_PROFILE__
+#define __ADC_PROFILE__
+
+// ADC acquisition profiles, shared by MCU & host HAL. ADC clock is 6 MHz
+// (SYSCLK / 8), and conversion takes sampling time + 12.5 cycles per
+// channel.
+//
+// - RAW: 160.5 cycles sampling, 1 conversion per sample (346 cycles per
+//   current & knob pair).
+// - HW_OVERSAMPLING: 7.5 cycles sampling, 8 conversions averaged by ADC
+//   (360 cycles per pair). Noise / sqrt(8) for free, but short sampling
+//   needs low impedance sources. Knob pot gets 12.5 cycles.
+// - SW_OVERSAMPLING: 39.5 cycles sampling, 4 conversions per sample,
+//   averaged by io (416 cycles per sample).
+//
+// Samples stay 12 bits. SAMPLING_RATE is defined by HAL.
+#define ADC_PROFILE_RAW 0
+#define ADC_PROFILE_HW_OVERSAMPLING 1
+#define ADC_PROFILE_SW_OVERSAMPLING 2
+
+#ifndef ADC_PROFILE
+#define ADC_PROFILE ADC_PROFILE_RAW
+#endif
+
+#if ADC_PROFILE == ADC_PROFILE_HW_OVERSAMPLING
+#define ADC_HW_OVERSAMPLE 8
+#define ADC_OVERSAMPLE 1
+#elif ADC_PROFILE == ADC_PROFILE_SW_OVERSAMPLING
+#define ADC_HW_OVERSAMPLE 1
+#define ADC_OVERSAMPLE 4
+#else
+#define ADC_HW_OVERSAMPLE 1
+#define ADC_OVERSAMPLE 1
+#endif
+
+// Samples per DMA interrupt (half of DMA buffer). Those go to main loop
+// as one block, to cut per sample interrupt & queue overhead. DMA takes
+// ADC_OVERSAMPLE conversions per sample.
+#define ADC_FETCH_PER_TICK (16 * ADC_OVERSAMPLE)
+
+// How many channels are sampled "in parallel".
+// Used to define global DMA buffer size.
+#define ADC_CHANNELS_COUNT 2
+
+// Channels order in DMA buffer (ADC sequencer ranks)
+#define ADC_CURRENT_RANK 0
+#define ADC_KNOB_RANK 1
+
+#endif
@@ -23,7 +23,6 @@ int main()
     // Load config info from emulated EEPROM
     //regulator.configure();
 
-    meter.configure();
     calibrator.configure();
     regulator.configure();
 
@@ -31,23 +30,21 @@ int main()
     else hal::set_power(F16(NOT_CALIBRATED_MOTOR_POWER));
 
     while (1) {
-        if (!io.out.empty())
-        {
-            io_data_t io_data;
-            io.out.pop(io_data);
+        // Collect all pending sample blocks. Meter does heavy work in
+        // tick(), by small steps, so queue should not overflow.
+        io_block_t block;
+        while (io.out.pop(block)) meter.consume(block);
 
-            if (meter.consume(io_data))
-            {
-                // if frequency was recalculated - drop overflowed queue
-                // and pass new value to regulator
-                regulator.freq_in = meter.frequency;
-                io.out.clear();
-            }
+        // If frequency was recalculated - pass new value to regulator
+        if (meter.tick())
+        {
+            regulator.measure(meter.frequency, meter.variance(), meter.quality.trusted());
+        }
 
-            calibrator.tick();
+        io.knob_tick();
+        calibrator.tick();
 
-            // Detach knob on calibration
-            if (!calibrator.active) regulator.apply_knob(io.knob);
-        }
+        // Detach knob on calibration
+        if (!calibrator.active) regulator.apply_knob(io.knob);
     }
 }
@@ -0,0 +1,76 @@
+#ifndef __BIN_MAGNITUDE__
+#define __BIN_MAGNITUDE__
+
+#include <stdint.h>
+#include "fft.h"
+
+// FFT bin power kernels. Exact one takes 2 int64 products per bin (library
+// calls on Cortex-M0+). Peak search only needs to compare bins, so it can
+// use cheaper approximation (METER_MAGNITUDE_KERNEL), and peak power is
+// then recalculated exactly for interpolation & SNR.
+
+#define METER_MAGNITUDE_EXACT 0
+#define METER_MAGNITUDE_PRESCALED 1
+#define METER_MAGNITUDE_ALPHA_BETA 2
+
+#ifndef METER_MAGNITUDE_KERNEL
+#define METER_MAGNITUDE_KERNEL METER_MAGNITUDE_PRESCALED
+#endif
+
+// Bin power. Tone of full ADC scale gives ~ 2^26 in bin, so shift keeps
+// enough resolution for noise floor (small bins should not become 0),
+// and can not overflow.
+#define METER_MAGNITUDE2_SHIFT 24
+
+static inline uint32_t bin_magnitude2(const fft_complex_t &bin)
+{
+    uint32_t acc0 = (uint32_t) (((int64_t)bin.r * bin.r ) >> METER_MAGNITUDE2_SHIFT);
+    uint32_t acc1 = (uint32_t) (((int64_t)bin.i * bin.i ) >> METER_MAGNITUDE2_SHIFT);
+    return acc0 + acc1;
+}
+
+// |val| >> (SHIFT / 2), rounded, limited to 15 bits. Squares of 2 such
+// values fit uint32, and need only 32-bit multiply. Limit is 16x above
+// full scale tone.
+static inline uint32_t bin_prescale(fft_t val)
+{
+    uint32_t a = val < 0 ? -(uint32_t)val : (uint32_t)val;
+    a = (a + (1 << (METER_MAGNITUDE2_SHIFT / 2 - 1))) >> (METER_MAGNITUDE2_SHIFT / 2);
+    return a > 0x7FFF ? 0x7FFF : a;
+}
+
+// Squares of 16 bits prescaled parts. The same scale as bin_magnitude2(),
+// error ~ 1 LSB of prescaled value (noticeable on weak bins only).
+static inline uint32_t bin_magnitude2_prescaled(const fft_complex_t &bin)
+{
+    uint32_t r = bin_prescale(bin.r);
+    uint32_t i = bin_prescale(bin.i);
+    return r * r + i * i;
+}
+
+// Alpha max plus beta min: |bin| ~ 15/16 * max + 15/32 * min (error
+// within 6.25%), squared to the same scale as bin_magnitude2(). One
+// 32-bit multiply per bin.
+static inline uint32_t bin_magnitude2_alpha_beta(const fft_complex_t &bin)
+{
+    uint32_t r = bin_prescale(bin.r);
+    uint32_t i = bin_prescale(bin.i);
+    uint32_t max = r > i ? r : i;
+    uint32_t min = r > i ? i : r;
+    uint32_t m = max - (max >> 4) + (min >> 1) - (min >> 5);
+    return m * m;
+}
+
+// Kernel for peak search, selected by METER_MAGNITUDE_KERNEL
+static inline uint32_t bin_magnitude2_search(const fft_complex_t &bin)
+{
+#if METER_MAGNITUDE_KERNEL == METER_MAGNITUDE_PRESCALED
+    return bin_magnitude2_prescaled(bin);
+#elif METER_MAGNITUDE_KERNEL == METER_MAGNITUDE_ALPHA_BETA
+    return bin_magnitude2_alpha_beta(bin);
+#else
+    return bin_magnitude2(bin);
+#endif
+}
+
+#endif
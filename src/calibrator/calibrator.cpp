@@ -16,7 +16,6 @@ bool Calibrator::tick()
 
     active = true;
     regulator.disable();
-    meter.magnitude2_treshold = 0;
 
     YIELD_WHILE(!calibrate_adrc());
     regulator.enable();
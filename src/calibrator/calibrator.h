@@ -21,7 +21,6 @@ private:
     bool wait_knob_dial();
 
     uint32_t ts;
-    uint64_t uint64_acc;
     fix16_t fix16_acc;
 
     fix16_t freq_max_speed;
@@ -56,7 +56,7 @@ bool Calibrator::calibrate_adrc()
     while (speed_tracker.is_stable())
     {
         YIELD_MS(100);
-        speed_tracker.push(fix16_from_int(meter.frequency));
+        if (meter.quality.intact()) speed_tracker.push(meter.frequency);
     }
 
     freq_max_speed = speed_tracker.average();
@@ -77,16 +77,16 @@ bool Calibrator::calibrate_adrc()
 
     hal::set_power(F16(0.1));
     // wait until speed fall to high point
-    YIELD_WHILE(fix16_from_int(meter.frequency) > freq_high_speed_point);
+    YIELD_WHILE(meter.frequency > freq_high_speed_point);
 
-    YIELD_WHILE(fix16_from_int(meter.frequency) > freq_low_speed_point);
+    YIELD_WHILE(meter.frequency > freq_low_speed_point);
     stop_time_ms = YIELD_GET_MS();
 
     //
     // Measure speed up time
     //
     hal::set_power(fix16_one);
-    YIELD_WHILE(fix16_from_int(meter.frequency) < freq_high_speed_point);
+    YIELD_WHILE(meter.frequency < freq_high_speed_point);
     start_time_ms = YIELD_GET_MS();
 
     // TODO: clarify
@@ -134,7 +134,7 @@ bool Calibrator::calibrate_adrc()
         while (!speed_tracker.is_stable() && (GET_TIMESTAMP() < ts + motor_start_stop_time))
         {
             YIELD_MS(100);
-            speed_tracker.push(fix16_from_int(meter.frequency));
+            if (meter.quality.intact()) speed_tracker.push(meter.frequency);
         };
 
         //
@@ -152,7 +152,12 @@ bool Calibrator::calibrate_adrc()
         {
             YIELD_MS(100);
 
-            fix16_t f = fix16_from_int(meter.frequency);
+            // Spurious lines from lost samples would look like oscillations.
+            // Don't use trusted() here, at max power ~ 40% of good
+            // estimates are not trusted (see REGULATOR_QUALITY_GATE).
+            if (!meter.quality.intact()) continue;
+
+            fix16_t f = meter.frequency;
 
             if (measure_amplitude_max_speed < f) measure_amplitude_max_speed = f;
             if (measure_amplitude_min_speed > f) measure_amplitude_min_speed = f;
@@ -211,7 +216,7 @@ bool Calibrator::calibrate_adrc()
         while (!speed_tracker.is_stable() && (GET_TIMESTAMP() < ts + motor_start_stop_time))
         {
             YIELD_MS(100);
-            speed_tracker.push(fix16_from_int(meter.frequency));
+            if (meter.quality.intact()) speed_tracker.push(meter.frequency);
         };
 
         //
@@ -229,7 +234,12 @@ bool Calibrator::calibrate_adrc()
         {
             YIELD_MS(100);
 
-            fix16_t f = fix16_from_int(meter.frequency);
+            // Spurious lines from lost samples would look like oscillations.
+            // Don't use trusted() here, at max power ~ 40% of good
+            // estimates are not trusted (see REGULATOR_QUALITY_GATE).
+            if (!meter.quality.intact()) continue;
+
+            fix16_t f = meter.frequency;
 
             if (measure_amplitude_max_speed < f) measure_amplitude_max_speed = f;
             if (measure_amplitude_min_speed > f) measure_amplitude_min_speed = f;
@@ -290,7 +300,7 @@ bool Calibrator::calibrate_adrc()
         while (!speed_tracker.is_stable() && (GET_TIMESTAMP() < ts + motor_start_stop_time))
         {
             YIELD_MS(100);
-            speed_tracker.push(fix16_from_int(meter.frequency));
+            if (meter.quality.intact()) speed_tracker.push(meter.frequency);
         };
 
         //
@@ -307,7 +317,12 @@ bool Calibrator::calibrate_adrc()
         {
             YIELD_MS(100);
 
-            fix16_t f = fix16_from_int(meter.frequency);
+            // Spurious lines from lost samples would look like oscillations.
+            // Don't use trusted() here, at max power ~ 40% of good
+            // estimates are not trusted (see REGULATOR_QUALITY_GATE).
+            if (!meter.quality.intact()) continue;
+
+            fix16_t f = meter.frequency;
 
             if (measure_amplitude_max_speed < f) measure_amplitude_max_speed = f;
             if (measure_amplitude_min_speed > f) measure_amplitude_min_speed = f;
@@ -356,7 +371,7 @@ bool Calibrator::calibrate_adrc()
     meter.reset_state();
 
     //--------------------------------------------------------------------------
-    // Calculate noise tresholds
+    // Calculate power treshold (meter noise floor is tracked online)
     //--------------------------------------------------------------------------
 
     // We should be at lowest speed, but wait for sure after regulator reload
@@ -365,28 +380,21 @@ bool Calibrator::calibrate_adrc()
     while (!speed_tracker.is_stable() && (GET_TIMESTAMP() < ts + motor_start_stop_time))
     {
         YIELD_MS(100);
-        speed_tracker.push(fix16_from_int(meter.frequency));
+        if (meter.quality.intact()) speed_tracker.push(meter.frequency);
     }
 
     iterations_count = 0;
-    uint64_acc = 0;
     fix16_acc = 0;
 
     while (iterations_count < 16)
     {
         YIELD_MS(100);
-        uint64_acc += meter.magnitude2;
         fix16_acc += regulator.power_out;
+        iterations_count++;
     }
 
-    meter.magnitude2_treshold = (uint32_t) ((uint64_acc / 16) * 0.7f);
     regulator.min_power_treshold = fix16_acc / 16;
 
-    eeprom_uint32_write(
-        CFG_METER_MAGNITUDE_NOISE_TRESHOLD_ADDR,
-        meter.magnitude2_treshold
-    );
-
     eeprom_uint32_write(
         CFG_MIN_POWER_TRESHOLD_ADDR,
         regulator.min_power_treshold
@@ -0,0 +1,58 @@
+#ifndef __CEPSTRUM__
+#define __CEPSTRUM__
+
+#include <stdint.h>
+#include "fft.h"
+
+// Cepstrum helpers for meter octave check.
+//
+// Log spectrum of motor current is a comb with harmonics spacing F (bins).
+// Cepstrum (transform of log spectrum) has lines at quefrency N/F, 2N/F...
+// For high speeds that's 1..4 points of N/2, mixed with spectrum envelope.
+// So the same is done in lag domain: autocorrelation of log spectrum (its
+// power cepstrum transform) at lag L is high when comb spacing is L or its
+// divider. For the strongest line P and candidate fundamental P/d:
+//
+// - P is fundamental => high at lag P, low at P/2 (lines vs gaps).
+// - P is 2nd harmonic => high at both P/2 and P.
+//
+// Log makes weak harmonics count the same as strong ones, that's why it's
+// more robust than harmonic sum, when one line dominates. Only candidate
+// lags are calculated, one sum of N products per lag.
+
+// log2(val), Q8. Mantissa is interpolated linearly (error < 0.09).
+static inline int32_t cepstrum_log2(uint32_t val)
+{
+    if (!val) return 0;
+
+    int32_t n = 31 - __builtin_clz(val);
+    uint32_t frac = n >= 8 ? (val >> (n - 8)) & 0xFF : (val << (8 - n)) & 0xFF;
+
+    return (n << 8) + (int32_t)frac;
+}
+
+// Autocorrelation of log spectrum (in .r, minus mean) in [from..to), at
+// fractional lag (Q8), normalized by number of products. Shifted spectrum
+// is interpolated linearly. Q8 differences are below 2^13, so products fit
+// int32.
+static inline int32_t cepstrum_correlation(const fft_complex_t log[], uint16_t from, uint16_t to,
+                                           uint32_t lag_q8, int32_t mean)
+{
+    uint16_t lag = lag_q8 >> 8;
+    int32_t frac = lag_q8 & 0xFF;
+
+    if (from + lag + 1 >= to) return 0;
+
+    int64_t sum = 0;
+
+    for (uint16_t k = from; k + lag + 1 < to; k++)
+    {
+        int32_t shifted = ((log[k + lag].r - mean) * (256 - frac) +
+            (log[k + lag + 1].r - mean) * frac) >> 8;
+        sum += (log[k].r - mean) * shifted;
+    }
+
+    return (int32_t)(sum / (to - from - lag - 1));
+}
+
+#endif
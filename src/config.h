@@ -34,7 +34,8 @@
 
 #define CFG_CALIBRATION_DONE_ADDR 2
 
-#define CFG_METER_MAGNITUDE_NOISE_TRESHOLD_ADDR 3
+// 3 - was meter noise treshold, now it's tracked online. Not reused,
+// to not pick up old value after firmware update.
 
 #define CFG_MIN_POWER_TRESHOLD_ADDR 4
 
@@ -0,0 +1,93 @@
+#ifndef __DECIMATOR_TEMPLATE__
+#define __DECIMATOR_TEMPLATE__
+
+#include <stdint.h>
+
+// CIC decimator by 2^bits (bits = 0..MAX_BITS, selected at runtime).
+//
+// ORDER integrators run at input rate, ORDER combs at output rate:
+//
+//   I(n) = I(n-1) + x(n)             (ORDER times)
+//   C(m) = I(m*D) - I((m-1)*D)       (ORDER times)
+//
+// No multiplications, 2 * ORDER adds per input sample. DC gain is D^ORDER,
+// so output is scaled back to ADC range by shift. Integrators overflow is
+// fine - unsigned wrap is cancelled by combs, if result fits 32 bits
+// (12 + ORDER * MAX_BITS bits).
+//
+// Frequency response is sinc^ORDER. At 1/4 of output rate, droop is ~ 3dB
+// and aliases (from 3/4 of output rate) are suppressed by ~ 30dB, for
+// ORDER 3. So, decimated band is used up to 1/4 of output rate only.
+//
+template <uint8_t ORDER = 3, uint8_t MAX_BITS = 3>
+class CicDecimatorTemplate {
+
+public:
+    static_assert(12 + ORDER * MAX_BITS <= 32, "CIC decimator: gain does not fit 32 bits");
+
+    static constexpr uint8_t MAX_FACTOR_BITS = MAX_BITS;
+
+    // Current decimation factor, 2^bits
+    uint8_t bits = 0;
+
+    CicDecimatorTemplate() { reset(); }
+
+    void set_bits(uint8_t new_bits)
+    {
+        bits = new_bits > MAX_BITS ? MAX_BITS : new_bits;
+        reset();
+    }
+
+    void reset()
+    {
+        for (uint8_t k = 0; k < ORDER; k++) { integrator[k] = 0; comb[k] = 0; }
+        count = 0;
+        // Combs need ORDER outputs to fill delays, drop those
+        warmup = ORDER;
+    }
+
+    // Returns true, when output sample is ready
+    bool apply(uint16_t sample, uint16_t &out)
+    {
+        if (bits == 0)
+        {
+            out = sample;
+            return true;
+        }
+
+        uint32_t v = sample;
+
+        for (uint8_t k = 0; k < ORDER; k++)
+        {
+            integrator[k] += v;
+            v = integrator[k];
+        }
+
+        if (++count < (1 << bits)) return false;
+        count = 0;
+
+        for (uint8_t k = 0; k < ORDER; k++)
+        {
+            uint32_t prev = comb[k];
+            comb[k] = v;
+            v -= prev;
+        }
+
+        if (warmup)
+        {
+            warmup--;
+            return false;
+        }
+
+        out = (uint16_t)(v >> (ORDER * bits));
+        return true;
+    }
+
+private:
+    uint32_t integrator[ORDER];
+    uint32_t comb[ORDER];
+    uint8_t count = 0;
+    uint8_t warmup = 0;
+};
+
+#endif
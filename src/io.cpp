@@ -1,16 +1,96 @@
 #include "io.h"
 
-void Io::consume(uint16_t adc_current_buf[], uint16_t adc_knob_buf[])
+void Io::consume(const adc_view_t &adc_current, const adc_view_t &adc_knob)
 {
-    // Simple smooth filter for knob
-    uint16_t new_knob = uint16_t((prev_knob * 15 + adc_knob_buf[0]) >> 4);
-    prev_knob = new_knob;
+    io_block_t block;
+    uint8_t n = 0;
+    uint32_t knob_acc = 0;
 
-    knob = new_knob << 4;
+    for (uint8_t i = 0; i < IO_BLOCK_SIZE; i++)
+    {
+        // Average conversions of sample (software oversampling)
+        uint32_t current_sum = 0;
 
-    io_data_t io_data;
-    io_data.current = adc_current_buf[0];
+        for (uint8_t k = 0; k < ADC_OVERSAMPLE; k++, n++)
+        {
+            current_sum += adc_current[n];
+            knob_acc += adc_knob[n];
+        }
 
-    // Push data to queue & drop queue content on overflow
-    out.push(io_data);
+        block.current[i] = uint16_t((current_sum + ADC_OVERSAMPLE / 2) / ADC_OVERSAMPLE);
+    }
+
+    // Knob is slow, only accumulate here
+    knob_sum += knob_acc;
+    knob_count += ADC_FETCH_PER_TICK;
+
+    block.dropped = dropped;
+
+    // Push data to queue. On overflow block is lost, and the next one
+    // carries the number of lost samples, for meter.
+    if (out.push(block))
+    {
+        dropped = 0;
+        stats.blocks++;
+
+        uint8_t fill = (uint8_t)out.size();
+        if (fill > stats.high_water) stats.high_water = fill;
+        return;
+    }
+
+    stats.overruns++;
+    stats.dropped += IO_BLOCK_SIZE;
+
+    if (dropped < UINT16_MAX - IO_BLOCK_SIZE) dropped += IO_BLOCK_SIZE;
+    else dropped = UINT16_MAX;
+}
+
+
+void Io::knob_tick()
+{
+    uint32_t now = GET_TIMESTAMP();
+
+    if (knob_started && (now - knob_ts < KNOB_PERIOD_MS)) return;
+
+    // Consistent snapshot: interrupt can come between reads, then count
+    // changes and we repeat.
+    uint32_t sum, count;
+    do {
+        count = knob_count;
+        sum = knob_sum;
+    } while (count != knob_count);
+
+    uint32_t d_sum = sum - knob_sum_prev;
+    uint32_t d_count = count - knob_count_prev;
+
+    if (!d_count) return;
+
+    knob_ts = now;
+    knob_sum_prev = sum;
+    knob_count_prev = count;
+
+    // 12-bit average => fix16, keeping fractional bits. 64-bit, because
+    // main loop can be late (flash write).
+    fix16_t value = (fix16_t)(((uint64_t)d_sum << 4) / d_count);
+
+    if (!knob_started)
+    {
+        knob_filtered = value;
+        knob_level = value;
+        knob_started = true;
+    }
+    else knob_filtered += (value - knob_filtered) >> KNOB_IIR_SHIFT;
+
+    if (knob_filtered > knob_level + F16(KNOB_HYSTERESIS))
+    {
+        knob_level = knob_filtered - F16(KNOB_HYSTERESIS);
+    }
+    else if (knob_filtered < knob_level - F16(KNOB_HYSTERESIS))
+    {
+        knob_level = knob_filtered + F16(KNOB_HYSTERESIS);
+    }
+
+    if (knob_level < F16(KNOB_DEAD_BAND)) knob = 0;
+    else if (knob_level > fix16_one - F16(KNOB_DEAD_BAND)) knob = fix16_one;
+    else knob = knob_level;
 }
@@ -3,30 +3,113 @@
 
 #include "etl/queue_spsc_atomic.h"
 #include "libfixmath/fix16.h"
+#include "app_hal.h"
+
+// Samples go to main loop by blocks, one per DMA interrupt. Queue depth
+// (in blocks) should cover the longest main loop iteration.
+#define IO_BLOCK_SIZE (ADC_FETCH_PER_TICK / ADC_OVERSAMPLE)
+
+#ifndef IO_QUEUE_BLOCKS
+#define IO_QUEUE_BLOCKS 4
+#endif
+
+// Knob task (main loop) update period, ms
+#ifndef KNOB_PERIOD_MS
+#define KNOB_PERIOD_MS 10
+#endif
+
+// Knob IIR: y += (x - y) / 2^SHIFT per update. 2 => time constant ~ 35ms
+#ifndef KNOB_IIR_SHIFT
+#define KNOB_IIR_SHIFT 2
+#endif
+
+// Knob output moves only when filtered value leaves +/- hysteresis band
+#ifndef KNOB_HYSTERESIS
+#define KNOB_HYSTERESIS 0.002
+#endif
+
+// Knob output snaps to 0 / 1 near the ends of scale
+#ifndef KNOB_DEAD_BAND
+#define KNOB_DEAD_BAND 0.01
+#endif
 
 struct io_data_t {
     uint16_t current = 0;
+    // Samples lost (queue overflow) right before this one
+    uint16_t dropped = 0;
+};
+
+struct io_block_t {
+    uint16_t current[IO_BLOCK_SIZE];
+    // Samples lost (queue overflow) right before this block
+    uint16_t dropped = 0;
+};
+
+// View of one channel in interleaved ADC DMA buffer, without copy. Sample
+// n is at data[n * stride], view spans ADC_FETCH_PER_TICK conversions.
+// Completed DMA half is not written until the next half is done, so it's
+// safe to read from interrupt.
+struct adc_view_t {
+    const volatile uint16_t *data;
+    uint8_t stride;
+
+    uint16_t operator[](uint8_t n) const { return data[n * stride]; }
+};
+
+// Pipeline health. Written by interrupt, can be read anytime (32-bit
+// fields are read atomically).
+struct io_stats_t {
+    // Blocks pushed to queue
+    uint32_t blocks = 0;
+    // Blocks lost on queue overflow, and their samples
+    uint32_t overruns = 0;
+    uint32_t dropped = 0;
+    // Max queue fill (blocks). Close to IO_QUEUE_BLOCKS => main loop
+    // iterations are too long.
+    uint8_t high_water = 0;
 };
 
 
 class Io
 {
 public:
-    // Output data to process in main loop. In theory should have 1 element max.
-    // Leave room for 3 more for sure.
-    etl::queue_spsc_atomic<io_data_t, 10, etl::memory_model::MEMORY_MODEL_SMALL> out;
+    // Output data to process in main loop. In theory should have 1 block max.
+    etl::queue_spsc_atomic<io_block_t, IO_QUEUE_BLOCKS, etl::memory_model::MEMORY_MODEL_SMALL> out;
 
-    // Calculated knob value
+    // Knob value [0..1], updated by knob_tick()
     fix16_t knob = 0;
 
-    // Eat raw adc data from interrupt, and:
-    // - produce knob value
-    // - fire current to queue (for postponed processing)
-    void consume(uint16_t adc_current_buf[], uint16_t adc_knob_buf[]);
+    io_stats_t stats;
+
+    // Eat raw adc data from interrupt (views of DMA buffer, ADC_FETCH_PER_TICK
+    // conversions), and:
+    // - average ADC_OVERSAMPLE conversions per sample
+    // - accumulate knob conversions (filtered later, in knob_tick())
+    // - fire current samples to queue as one block (for postponed processing)
+    void consume(const adc_view_t &adc_current, const adc_view_t &adc_knob);
+
+    // Low rate knob task, call from main loop. Every KNOB_PERIOD_MS takes
+    // knob average since the previous update, and applies IIR, hysteresis
+    // & dead-band.
+    void knob_tick();
 
 private:
-    // Previous iteration values
-    fix16_t prev_knob = 0;
+    // Knob conversions sum & count, written by interrupt only. Free running
+    // (wrap), knob_tick() takes difference with the previous snapshot.
+    volatile uint32_t knob_sum = 0;
+    volatile uint32_t knob_count = 0;
+
+    uint32_t knob_sum_prev = 0;
+    uint32_t knob_count_prev = 0;
+    uint32_t knob_ts = 0;
+    bool knob_started = false;
+
+    // IIR output, and hysteresis output
+    fix16_t knob_filtered = 0;
+    fix16_t knob_level = 0;
+
+    // Samples, not pushed to queue since the last successful push
+    uint16_t dropped = 0;
 };
 
 
@@ -0,0 +1,362 @@
+#ifndef __MAINS_FILTER_TEMPLATE__
+#define __MAINS_FILTER_TEMPLATE__
+
+#include <stdint.h>
+#include "libfixmath/fix16.h"
+#include "sine_table.h"
+
+// Mains frequency, used until detected.
+#ifndef MAINS_FILTER_DEFAULT_FREQUENCY
+#define MAINS_FILTER_DEFAULT_FREQUENCY 50
+#endif
+
+constexpr double MAINS_FILTER_PI = 3.14159265358979323846;
+
+// cos & sin for any angle in [-PI..PI], Q14
+constexpr int32_t mains_filter_cos_q14(double x)
+{
+    return (int32_t)(16384 * sine_table_taylor(x + MAINS_FILTER_PI / 2));
+}
+
+constexpr int32_t mains_filter_sin_q14(double x)
+{
+    return (int32_t)(16384 * sine_table_taylor(x));
+}
+
+// Phase advance of tone per `samples`, minus whole turns, [-PI..PI]
+constexpr double mains_filter_rotation(uint32_t freq, uint32_t samples, uint32_t rate)
+{
+    return 2 * MAINS_FILTER_PI * ((double)(freq * samples % rate) / rate) -
+        ((freq * samples % rate) * 2 > rate ? 2 * MAINS_FILTER_PI : 0);
+}
+
+// Mains ripple filter. Removes DC and rectified mains ripple (harmonics of
+// 100/120Hz, rectifier has no odd mains harmonics) below MAX_FREQUENCY, and
+// keeps everything above untouched.
+//
+// Each ripple harmonic k is cancelled by adaptive notch (LMS canceller with
+// cos/sin reference, equivalent to 2nd order IIR notch):
+//
+//   y(n) = x(n) - sum(a_k * cos(k*wt) + b_k * sin(k*wt))
+//   a_k += mu * y(n) * cos(k*wt), b_k += mu * y(n) * sin(k*wt)
+//
+// Notch width is ~ mu * SAMPLE_RATE / PI (~ 5Hz), ripple is suppressed by
+// ~ 60dB. k = 0 is DC.
+//
+// Plain comb filter (y(n) = x(n) - avg(n - mains period)) is cheaper, but
+// notches all harmonics up to Nyquist - including ones, where motor lives
+// (rpm_low record has motor line at 12 * 50Hz and is blinded).
+//
+// Notches are narrow, and real mains (and ADC clock) are never exact. Records
+// have ripple at 100.4Hz - that's 4Hz error at 1kHz. So, ripple frequency is
+// tracked:
+//
+// - Samples are decimated by 16 (simple sum), and two Goertzel filters
+//   (100 & 120Hz) run on every DETECT_LENGTH decimated samples.
+// - 50 or 60Hz mains is selected by ripple power (16x above other one),
+//   if confirmed by DETECT_CONFIRM blocks in a row. Real ripple is ~ 60dB
+//   above, but noise gives 16x in ~ 1/8 of blocks, so a single block is not
+//   enough. No ripple (motor stopped) => no decision, state is kept.
+// - Ripple phase advance between blocks gives exact frequency.
+//
+template <uint32_t SAMPLE_RATE, uint16_t MAX_FREQUENCY = 500, uint8_t MU_SHIFT = 10>
+class MainsFilterTemplate {
+
+public:
+    // Output is signed, centered around OFFSET (in ADC scale)
+    static constexpr uint16_t OFFSET = 2048;
+    static constexpr uint16_t MAX_OUT = 4095;
+
+    // DC + harmonics of 100Hz ripple (120Hz needs less)
+    static constexpr uint8_t MAX_HARMONICS = MAX_FREQUENCY / 100 + 1;
+
+    static constexpr uint8_t DECIMATION_BITS = 4;
+    static constexpr uint16_t DETECT_LENGTH = 128;
+    static constexpr uint8_t DETECT_CONFIRM = 3;
+
+    // Max deviation of ripple frequency from nominal, Hz. Phase advance
+    // between detector blocks should stay in +/- PI/2.
+    static constexpr fix16_t MAX_DEVIATION = F16(1.5);
+
+    static_assert(DETECT_LENGTH * (1 << DECIMATION_BITS) * MAX_DEVIATION / 65536 * 4 < SAMPLE_RATE,
+        "Mains filter: detector block is too long for frequency tracking");
+
+    // Detected (or default) mains frequency, Hz
+    uint8_t mains_frequency = MAINS_FILTER_DEFAULT_FREQUENCY;
+    // true, when mains frequency was detected
+    bool detected = false;
+    // Tracked ripple frequency (2x mains), Hz
+    fix16_t ripple_frequency = fix16_from_int(MAINS_FILTER_DEFAULT_FREQUENCY * 2);
+
+    // Notches need ~ 5 time constants (2^MU_SHIFT samples each) to converge
+    // (leftovers e^-5 ~ -43dB). Output has ripple until then.
+    static constexpr uint16_t SETTLE_SAMPLES = 5 << MU_SHIFT;
+    bool settled = false;
+
+    MainsFilterTemplate() { reset(); }
+
+    // Restart filter (keeps detected mains)
+    void reset()
+    {
+        set_step();
+        harmonics = MAX_FREQUENCY / (mains_frequency * 2) + 1;
+        phase = 0;
+        primed = false;
+        settled = false;
+        settle_count = 0;
+
+        for (uint8_t k = 0; k < MAX_HARMONICS; k++) { weight_cos[k] = 0; weight_sin[k] = 0; }
+    }
+
+    uint16_t apply(uint16_t sample)
+    {
+        detect(sample);
+
+        // Fast start, from the first sample as DC
+        if (!primed)
+        {
+            weight_cos[0] = (int32_t)sample << 16;
+            primed = true;
+        }
+
+        int32_t ref_cos[MAX_HARMONICS], ref_sin[MAX_HARMONICS];
+
+        // DC, Q16 => Q4
+        int32_t estimate = weight_cos[0] >> 12;
+
+        for (uint8_t k = 1; k < harmonics; k++)
+        {
+            uint32_t pos = phase * k;
+
+            ref_cos[k] = Sine::fastcos(pos) >> 17;
+            ref_sin[k] = Sine::fastsin(pos) >> 17;
+
+            // Q6 weight * Q14 reference => Q4. Weights are limited
+            // to 1/4 of ADC scale, so products fit int32.
+            estimate += ((weight_cos[k] >> 10) * ref_cos[k]) >> 16;
+            estimate += ((weight_sin[k] >> 10) * ref_sin[k]) >> 16;
+        }
+
+        // Error (= output), Q4
+        int32_t error = ((int32_t)sample << 4) - estimate;
+        int32_t e = error > MAX_ERROR ? MAX_ERROR : (error < -MAX_ERROR ? -MAX_ERROR : error);
+
+        weight_cos[0] += (e << 12) >> MU_SHIFT;
+
+        for (uint8_t k = 1; k < harmonics; k++)
+        {
+            weight_cos[k] = clamp_weight(weight_cos[k] + ((e * ref_cos[k]) >> (2 + MU_SHIFT)));
+            weight_sin[k] = clamp_weight(weight_sin[k] + ((e * ref_sin[k]) >> (2 + MU_SHIFT)));
+        }
+
+        phase += phase_step;
+
+        if (!settled && ++settle_count >= SETTLE_SAMPLES) settled = true;
+
+        int32_t out = (error >> 4) + OFFSET;
+
+        if (out < 0) return 0;
+        if (out > MAX_OUT) return MAX_OUT;
+        return (uint16_t)out;
+    }
+
+private:
+    static constexpr double PI = MAINS_FILTER_PI;
+    static constexpr uint32_t DECIMATED_RATE = SAMPLE_RATE >> DECIMATION_BITS;
+    static constexpr uint32_t BLOCK_SAMPLES = (uint32_t)DETECT_LENGTH << DECIMATION_BITS;
+
+    // Reference oscillator. 1024 points per turn is enough - phase noise
+    // of lookup without interpolation is ~ -50dB.
+    typedef SineTableTemplate<8> Sine;
+
+    // Harmonics weights, Q16 (ADC scale). weight_cos[0] is DC.
+    int32_t weight_cos[MAX_HARMONICS];
+    int32_t weight_sin[MAX_HARMONICS];
+    uint8_t harmonics = 0;
+
+    // Ripple phase, full turn = 2^32
+    uint32_t phase = 0;
+    uint32_t phase_step = 0;
+    bool primed = false;
+    uint16_t settle_count = 0;
+
+    // Error for weights update, Q4. Limited to keep products in int32.
+    static constexpr int32_t MAX_ERROR = (1 << 16) - 1;
+    static constexpr int32_t MAX_WEIGHT = 1024 << 16;
+
+    static int32_t clamp_weight(int32_t w)
+    {
+        if (w > MAX_WEIGHT) return MAX_WEIGHT;
+        if (w < -MAX_WEIGHT) return -MAX_WEIGHT;
+        return w;
+    }
+
+    // Goertzel filter for single frequency, Q14 coefficients
+    template <uint16_t FREQ>
+    struct Goertzel {
+        static constexpr double OMEGA = 2 * PI * FREQ / DECIMATED_RATE;
+        static constexpr int32_t COS = mains_filter_cos_q14(OMEGA);
+        static constexpr int32_t SIN = mains_filter_sin_q14(OMEGA);
+        // To remove expected phase advance between blocks
+        static constexpr double ROTATION = mains_filter_rotation(FREQ, BLOCK_SAMPLES, SAMPLE_RATE);
+        static constexpr int32_t ROT_COS = mains_filter_cos_q14(ROTATION);
+        static constexpr int32_t ROT_SIN = mains_filter_sin_q14(ROTATION);
+
+        int32_t s1 = 0, s2 = 0;
+
+        void reset() { s1 = 0; s2 = 0; }
+
+        void push(int32_t x)
+        {
+            int32_t s = x + (int32_t)(((int64_t)COS * 2 * s1) >> 14) - s2;
+            s2 = s1;
+            s1 = s;
+        }
+
+        uint64_t power() const
+        {
+            int64_t p = (int64_t)s1 * s1 + (int64_t)s2 * s2 -
+                ((((int64_t)COS * 2 * s1) >> 14) * s2);
+            return p > 0 ? (uint64_t)p : 0;
+        }
+
+        // Complex result, scaled down to 15 bits
+        void result(int32_t &re, int32_t &im) const
+        {
+            int64_t r = (int64_t)s1 - (((int64_t)COS * s2) >> 14);
+            int64_t i = ((int64_t)SIN * s2) >> 14;
+
+            while (r >= (1 << 15) || r <= -(1 << 15) || i >= (1 << 15) || i <= -(1 << 15))
+            {
+                r >>= 1;
+                i >>= 1;
+            }
+
+            re = (int32_t)r;
+            im = (int32_t)i;
+        }
+    };
+
+    Goertzel<100> goertzel_100;
+    Goertzel<120> goertzel_120;
+
+    uint32_t dec_acc = 0;
+    uint32_t dec_prev = 0;
+    uint8_t dec_count = 0;
+    uint16_t detect_count = 0;
+    // Last decision, 0 if none, and how many blocks in a row agree
+    uint8_t vote = 0;
+    uint8_t votes = 0;
+    // Ripple phasor of previous block
+    int32_t prev_re = 0, prev_im = 0;
+
+    void set_step()
+    {
+        // step = ripple / SAMPLE_RATE * 2^32
+        phase_step = (uint32_t)(((uint64_t)ripple_frequency << 16) / SAMPLE_RATE);
+    }
+
+    // atan2 for angles in [-PI/2..PI/2] (re > 0), fix16 radians.
+    // atan(r) ~ r * (PI/4 + 0.273 * (1 - |r|)), error < 0.005 rad.
+    static fix16_t angle(int64_t re, int64_t im)
+    {
+        int64_t abs_im = im < 0 ? -im : im;
+        bool swap = abs_im > re;
+        fix16_t r = (fix16_t)(((swap ? re : abs_im) << 16) / (swap ? abs_im : re));
+        fix16_t a = fix16_mul(r, F16(PI / 4) + fix16_mul(F16(0.273), fix16_one - r));
+
+        if (swap) a = F16(PI / 2) - a;
+        return im < 0 ? -a : a;
+    }
+
+    template <uint16_t FREQ>
+    void track(const Goertzel<FREQ> &g, bool continuous)
+    {
+        int32_t re, im;
+        g.result(re, im);
+
+        if (continuous)
+        {
+            // d = X * conj(X_prev) * e^(-j * expected rotation)
+            int64_t dr = (int64_t)re * prev_re + (int64_t)im * prev_im;
+            int64_t di = (int64_t)im * prev_re - (int64_t)re * prev_im;
+            int64_t rr = (dr * Goertzel<FREQ>::ROT_COS + di * Goertzel<FREQ>::ROT_SIN) >> 14;
+            int64_t ri = (di * Goertzel<FREQ>::ROT_COS - dr * Goertzel<FREQ>::ROT_SIN) >> 14;
+
+            if (rr > 0)
+            {
+                // Frequency offset = phase / (2 * PI * block time)
+                fix16_t offset = fix16_mul(angle(rr, ri),
+                    F16((double)SAMPLE_RATE / (2 * PI * BLOCK_SAMPLES)));
+
+                fix16_t nominal = fix16_from_int(FREQ);
+                fix16_t freq = ripple_frequency + ((nominal + offset - ripple_frequency) >> 1);
+
+                if (freq > nominal + MAX_DEVIATION) freq = nominal + MAX_DEVIATION;
+                if (freq < nominal - MAX_DEVIATION) freq = nominal - MAX_DEVIATION;
+
+                ripple_frequency = freq;
+                set_step();
+            }
+        }
+
+        prev_re = re;
+        prev_im = im;
+    }
+
+    void detect(uint16_t sample)
+    {
+        dec_acc += sample;
+        if (++dec_count < (1 << DECIMATION_BITS)) return;
+
+        // Difference of decimated samples drops DC, which would leak
+        // into Goertzel bins.
+        int32_t x = (int32_t)dec_acc - (int32_t)dec_prev;
+        dec_prev = dec_acc;
+        dec_acc = 0;
+        dec_count = 0;
+
+        goertzel_100.push(x);
+        goertzel_120.push(x);
+
+        if (++detect_count < DETECT_LENGTH) return;
+
+        uint64_t p100 = goertzel_100.power();
+        uint64_t p120 = goertzel_120.power();
+        uint8_t freq = 0;
+
+        if (p100 > p120 * 16) freq = 50;
+        else if (p120 > p100 * 16) freq = 60;
+
+        bool continuous = freq && freq == vote;
+
+        if (!freq) votes = 0;
+        else if (!continuous) votes = 1;
+        else if (votes < DETECT_CONFIRM) votes++;
+
+        if (votes >= DETECT_CONFIRM)
+        {
+            detected = true;
+
+            if (freq != mains_frequency)
+            {
+                mains_frequency = freq;
+                ripple_frequency = fix16_from_int(freq * 2);
+                reset();
+            }
+        }
+
+        if (detected && freq == mains_frequency)
+        {
+            if (freq == 50) track(goertzel_100, continuous);
+            else track(goertzel_120, continuous);
+        }
+
+        vote = freq;
+        detect_count = 0;
+        goertzel_100.reset();
+        goertzel_120.reset();
+    }
+};
+
+#endif
@@ -3,42 +3,41 @@
 
 
 #include "app_hal.h"
-#include "io.h"
-#include "fft.h"
+#include "meter_template.h"
+#include "zero_crossing_meter.h"
 
 
-#define FFT_SIZE 512
+// Samples are collected into compact uint16 ring (2 bytes per sample), and
+// expanded into FFT workspace only when FFT starts. For 512 points that's
+// 1K history + 2K workspace (real FFT), instead of 4K for complex samples.
+// That leaves room for 1024 points (~ 6.5K of 8K RAM), use -DFFT_SIZE_BITS=10
+// (test_native_fft1024 env runs tests with it).
+#ifndef FFT_SIZE_BITS
 #define FFT_SIZE_BITS 9
+#endif
 
-// We should filter 100/120Hz + 2/3/4 harmonics
-#define FFT_TRESHOLD_FREQUENCY 500
-
-// Number of points to ignore from the start
-#define FFT_SKIP_POINTS (FFT_TRESHOLD_FREQUENCY * FFT_SIZE / SAMPLING_RATE + 1)
-
-class Meter
-{
-public:
-
-    // Detected frequency & RPM
-    uint32_t frequency = 0;
-    uint32_t rpm = 0;
-
-    // Detected energy^2 (for noise treshold)
-    uint32_t magnitude2 = 0;
-
-    // Noise treshold, if below => force speed = 0
-    uint32_t magnitude2_treshold = 0;
-
-    void configure();
-    bool consume(io_data_t &io_data);
-    void reset_state();
+// Speed estimation engine. Both have the same interface for app:
+// consume(), tick(), reset_state() & frequency.
+//
+// - FFT: spectrum peak, robust to noise & neighbour lines, estimate per hop.
+// - Zero crossing: band-pass + periods, ~ 3x less CPU & no buffers,
+//   estimate per period. Weaker on noisy signal and slow to find speed
+//   after start (see doc/math.md).
+#define METER_ENGINE_FFT 0
+#define METER_ENGINE_ZERO_CROSSING 1
+
+#ifndef METER_ENGINE
+#define METER_ENGINE METER_ENGINE_FFT
+#endif
 
-private:
-    uint16_t collected = 0;
+typedef MeterTemplate<FFT_SIZE_BITS, SAMPLING_RATE> FftMeter;
+typedef ZeroCrossingMeterTemplate<SAMPLING_RATE> ZeroCrossingMeter;
 
-    fft_complex_t fft_buf[FFT_SIZE];
-};
+#if METER_ENGINE == METER_ENGINE_ZERO_CROSSING
+typedef ZeroCrossingMeter Meter;
+#else
+typedef FftMeter Meter;
+#endif
 
 
 #endif
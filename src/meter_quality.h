@@ -0,0 +1,53 @@
+#ifndef __METER_QUALITY__
+#define __METER_QUALITY__
+
+#include <stdint.h>
+#include "libfixmath/fix16.h"
+
+// Min peak/noise power ratio of trusted estimate. Between METER_SNR_OFF
+// (speed is still reported) and METER_SNR_ON (speed is found).
+#ifndef METER_QUALITY_MIN_SNR
+#define METER_QUALITY_MIN_SNR 16
+#endif
+
+// Max power of the second spectrum line, relative to the first one, for
+// trusted estimate. Close lines can swap on the next frame.
+#ifndef METER_QUALITY_MAX_SECOND_PEAK
+#define METER_QUALITY_MAX_SECOND_PEAK 0.5
+#endif
+
+
+// Quality of the last speed estimate. Updated by meter together with
+// frequency, to let consumers tell a clean lock from a noisy guess.
+struct MeterQuality {
+    // Peak / noise floor power ratio. 0 when there is no signal.
+    fix16_t peak_to_noise = 0;
+
+    // Second strongest spectrum line (outside of the first one lobe) /
+    // the strongest one, power ratio, 0..1.
+    fix16_t second_peak = 0;
+
+    // Samples lost (input queue overflow) since the previous estimate.
+    // Spectrum of a broken sequence has spurious lines.
+    uint16_t dropped = 0;
+
+    // No samples lost inside of samples span, used by estimate. FFT meter
+    // skips frames with gaps, so that's for other methods mostly.
+    bool contiguous = true;
+
+    // Meter sample clock (input samples since start, wraps) of the newest
+    // sample, used by estimate. FFT window spans FFT size before it.
+    uint32_t timestamp = 0;
+
+    // No samples lost, estimate is made from unbroken input
+    bool intact() const { return dropped == 0 && contiguous; }
+
+    bool trusted() const
+    {
+        return peak_to_noise >= F16(METER_QUALITY_MIN_SNR) &&
+            second_peak <= F16(METER_QUALITY_MAX_SECOND_PEAK) &&
+            intact();
+    }
+};
+
+#endif
@@ -0,0 +1,1142 @@
+#ifndef __METER_TEMPLATE__
+#define __METER_TEMPLATE__
+
+
+#include "libfixmath/fix16.h"
+#include "io.h"
+#include "config.h"
+#include "fft.h"
+#include "sine_table.h"
+#include "sdft_tracker.h"
+#include "pll_tracker.h"
+#include "peak_interpolation.h"
+#include "noise_floor.h"
+#include "bin_magnitude.h"
+#include "cepstrum.h"
+#include "meter_quality.h"
+#include "mains_filter.h"
+#include "decimator.h"
+#include "window.h"
+
+
+// Spectrum is recalculated every (FFT_SIZE / METER_FFT_OVERLAP) new samples,
+// over the last FFT_SIZE samples. 2 and 4 give 2x and 4x more speed updates
+// per second at cost of proportionally more CPU time. Set 1 to disable
+// overlap.
+#ifndef METER_FFT_OVERLAP
+#define METER_FFT_OVERLAP 2
+#endif
+
+// We should filter 100/120Hz + 2/3/4 harmonics
+#define FFT_TRESHOLD_FREQUENCY 500
+
+// Mains ripple filter (see mains_filter.h) in front of FFT. Removes
+// 50/60Hz mains harmonics, so low bins can be used, and speed is measured
+// from FFT_FILTERED_TRESHOLD_FREQUENCY instead of FFT_TRESHOLD_FREQUENCY.
+#ifndef METER_MAINS_FILTER
+#define METER_MAINS_FILTER 1
+#endif
+
+#define FFT_FILTERED_TRESHOLD_FREQUENCY 150
+
+// Zoom mode for low speed. Samples are decimated by 2/4/8 (CIC, see
+// decimator.h) before history, so the same FFT gives 2..8x smaller bins
+// (and takes 2..8x less CPU per second, with 2..8x less updates).
+// Decimation is selected by last speed: it should be below 1/4 of
+// decimated rate. Narrower band is taken when speed falls below 3/4 of its
+// limit, to not jump back and forth. Without signal, meter returns to full
+// band.
+#ifndef METER_DECIMATION
+#define METER_DECIMATION 0
+#endif
+
+#define METER_DECIMATION_MAX_BITS 3
+#define METER_CIC_ORDER 3
+
+// Use real-input FFT. Samples are packed into FFT_SIZE/2 complex points
+// (even => .r, odd => .i), and result is converted to real spectrum
+// after transform. ~ 2x faster and takes half of RAM.
+#ifndef METER_REAL_FFT
+#define METER_REAL_FFT 1
+#endif
+
+// Run FFT passes by pairs, with radix-4 butterflies (see SYLT-FFT
+// fft_forward_pass_radix4). ~ 20% less multiplies and half of memory
+// sweeps. Each step does a pair of passes, so takes 2x more time per tick.
+// Library has no own switch, fft_forward() is always radix-2.
+#ifndef METER_FFT_RADIX4
+#define METER_FFT_RADIX4 0
+#endif
+
+// FFT window (see window.h). Coefficients are in flash, and applied while
+// history is unrolled into FFT workspace (integer multiply per sample, no
+// extra pass). Tracker (sliding DFT) always uses rectangular one.
+#ifndef METER_WINDOW
+#define METER_WINDOW WINDOW_RECTANGULAR
+#endif
+
+// Sub-bin peak interpolation method
+#define METER_PEAK_INTERPOLATION_NONE 0
+#define METER_PEAK_INTERPOLATION_PARABOLIC 1
+#define METER_PEAK_INTERPOLATION_JACOBSEN 2
+
+#ifndef METER_PEAK_INTERPOLATION
+#define METER_PEAK_INTERPOLATION METER_PEAK_INTERPOLATION_JACOBSEN
+#endif
+
+// Tracking mode. After FFT finds a peak, a small bank of sliding DFT bins
+// around it is updated on every sample, and speed is estimated every
+// METER_TRACKER_HOP samples (~ 1ms). If peak is lost (moved to bank edge
+// or fell below noise treshold), meter falls back to full FFT.
+// FFT also revalidates tracked peak every 4 windows.
+#ifndef METER_TRACKER
+#define METER_TRACKER 0
+#endif
+
+#define METER_TRACKER_BINS 5
+#define METER_TRACKER_HOP 16
+
+// Phase locked loop mode. FFT peak starts PLL, which follows speed line at
+// sample rate, and gives smooth frequency every METER_PLL_HOP samples
+// (~ 1ms). FFT keeps running - if loop is not locked, FFT result is used,
+// and if loop went away from FFT peak, it's restarted.
+#ifndef METER_PLL
+#define METER_PLL 0
+#endif
+
+// Loop bandwidth, Hz. Wider => faster lock & reaction, but more jitter
+#ifndef METER_PLL_BANDWIDTH
+#define METER_PLL_BANDWIDTH 20
+#endif
+
+#define METER_PLL_HOP 16
+
+// Harmonic check of FFT peak. Commutation ripple harmonics can be stronger
+// than fundamental, and max bin gives 2x speed error. Sub-harmonics of max
+// bin (1/2..1/METER_HARMONIC_MAX_DIVIDER) are scored by harmonic sum (power
+// of fundamental + its 2nd..METER_HARMONICS harmonics), and the best one is
+// used. Candidate should have at least 1/METER_HARMONIC_MIN_RATIO of max line
+// power, to avoid noise pick up.
+//
+// Records have real lines at 1/3 and 1/4 of ripple frequency (up to 0.37 of
+// its power), so only 1/2 is checked by default.
+#ifndef METER_HARMONIC_CHECK
+#define METER_HARMONIC_CHECK 1
+#endif
+
+#define METER_HARMONICS 4
+#define METER_HARMONIC_MAX_DIVIDER 2
+#define METER_HARMONIC_MIN_RATIO 4
+
+// Cepstrum octave check (see cepstrum.h). Runs only when harmonic check
+// kept max line, but is not confident (below METER_CEPSTRUM_CONFIDENCE),
+// and max line has usable sub-harmonic, and decides between those
+// instead. Log spectrum is made in place (fft_buf), and its
+// autocorrelation is taken at candidates lags, one lag per tick. So
+// estimate comes a few ticks later.
+#ifndef METER_CEPSTRUM
+#define METER_CEPSTRUM 0
+#endif
+
+#define METER_CEPSTRUM_CONFIDENCE 0.25
+// Sub-harmonic wins, if its comb correlation is at least 1/N of max line one
+#define METER_CEPSTRUM_MIN_RATIO 4
+
+// Noise floor tracking speed (1/2^N per FFT frame) and peak/noise power
+// ratios to start & stop reporting speed. See noise_floor.h.
+#ifndef METER_NOISE_TRACK_SHIFT
+#define METER_NOISE_TRACK_SHIFT 4
+#endif
+
+#ifndef METER_SNR_ON
+#define METER_SNR_ON 24
+#endif
+
+#ifndef METER_SNR_OFF
+#define METER_SNR_OFF 12
+#endif
+
+// Min noise floor, a few ADC LSB of noise. Motor start gives ~ 2500.
+#ifndef METER_NOISE_FLOOR_MIN
+#define METER_NOISE_FLOOR_MIN 16
+#endif
+
+// Predicted band peak search. While speed is found and trusted, peak is
+// searched only near the last one: +/- (main lobe + METER_BAND_MARGIN_BINS +
+// max speed change since last estimate) bins. Full spectrum is scanned
+// every METER_BAND_FULL_SCAN frames, after untrusted estimate, and when
+// band has no peak (lost or at band edge).
+#ifndef METER_BAND_SEARCH
+#define METER_BAND_SEARCH 1
+#endif
+
+// Max speed change, Hz per second. Default 4000 => from 0 to max speed
+// (CFG_RPM_MAX_DEFAULT, 4000 Hz) in ~ 1 second.
+#ifndef METER_BAND_MAX_ACCEL
+#define METER_BAND_MAX_ACCEL 4000
+#endif
+
+#define METER_BAND_MARGIN_BINS 4
+#define METER_BAND_FULL_SCAN 8
+
+// Method, used for last estimate
+enum MeterMethod {
+    METER_METHOD_NONE,      // No signal (peak is too close to noise floor)
+    METER_METHOD_FFT_PEAK,  // Max FFT bin
+    METER_METHOD_HARMONIC,  // Sub-harmonic of max bin, by harmonic sum
+    METER_METHOD_TRACKER,   // Sliding DFT tracker
+    METER_METHOD_PLL        // Phase locked loop
+};
+
+
+// FFT is done in small steps (one butterflies pass, peak search etc.),
+// one step per tick(), to keep main loop latency low. New samples are
+// collected into history while FFT works on own buffer.
+enum MeterFftStep {
+    FFT_STEP_IDLE,
+    FFT_STEP_LOAD,
+    FFT_STEP_PERMUTATE,
+    FFT_STEP_PASS,
+    FFT_STEP_CONVERT,
+    FFT_STEP_PEAK,
+    FFT_STEP_CEPSTRUM_LOG,
+    FFT_STEP_CEPSTRUM_LAG,
+    FFT_STEP_SEED
+};
+
+
+// Speed meter. FFT of last 2^FFT_BITS samples, taken at SAMPLE_RATE.
+// All sizes, scales and twiddle tables are calculated at compile time.
+// TWIDDLE_BITS defines sine table size (precision vs flash size), should
+// be at least FFT_BITS - 2. WINDOW is FFT window type.
+template <uint8_t FFT_BITS, uint32_t SAMPLE_RATE,
+    uint8_t TWIDDLE_BITS = FFT_BITS - 2, uint8_t WINDOW = METER_WINDOW>
+class MeterTemplate
+{
+public:
+    static constexpr uint16_t SIZE = 1 << FFT_BITS;
+    static constexpr uint16_t HOP_SIZE = SIZE / METER_FFT_OVERLAP;
+
+    // Raw ADC data is 12 bits. Scale it up to use fft_t range
+    // (FFT divides data by 2 on each stage, so overflow is not possible).
+    // Real FFT output is 4x bigger, so it gets 2 bits less - to keep
+    // the same magnitudes scale.
+    static constexpr uint8_t BUF_BITS = METER_REAL_FFT ? FFT_BITS - 1 : FFT_BITS;
+    static constexpr uint16_t BUF_SIZE = 1 << BUF_BITS;
+    static constexpr uint8_t INPUT_SHIFT = METER_REAL_FFT ? 14 : 16;
+
+    // Number of points to ignore from the start (without decimation)
+    static constexpr uint16_t SKIP_POINTS = FFT_TRESHOLD_FREQUENCY * SIZE / SAMPLE_RATE + 1;
+    static constexpr uint16_t FILTERED_SKIP_POINTS =
+        FFT_FILTERED_TRESHOLD_FREQUENCY * SIZE / SAMPLE_RATE + 1;
+
+    // Bin width, Hz (without decimation)
+    static constexpr fix16_t BIN_HZ = F16((double)SAMPLE_RATE / SIZE);
+
+    static constexpr uint16_t TRACKER_REFRESH = SIZE * 4;
+
+    static_assert(FFT_BITS <= TWIDDLE_BITS + 2, "Sine table is too small for FFT size");
+    static_assert(HOP_SIZE > 0 && HOP_SIZE <= SIZE, "METER_FFT_OVERLAP must be in [1..FFT size]");
+
+    // Detected frequency (Hz) & RPM
+    fix16_t frequency = 0;
+    uint32_t rpm = 0;
+
+    // Detected energy^2
+    uint32_t magnitude2 = 0;
+
+    // Spectrum noise floor & signal state. If peak is not well above
+    // noise => speed = 0.
+    NoiseFloorTemplate<
+        METER_NOISE_TRACK_SHIFT,
+        METER_SNR_ON,
+        METER_SNR_OFF,
+        METER_NOISE_FLOOR_MIN
+    > noise;
+
+    // How last frequency was found, and confidence of FFT peak choice
+    // (0..1, relative margin of harmonic sum from the next candidate,
+    // 0 if rejected candidate has better sum).
+    MeterMethod method = METER_METHOD_NONE;
+    fix16_t confidence = 0;
+
+    // Quality of last estimate (SNR, second line, lost samples, time)
+    MeterQuality quality;
+
+    // Check FFT peak with harmonics sum
+    bool harmonic_check = METER_HARMONIC_CHECK;
+
+    // Check ambiguous harmonic sum result with cepstrum, and true if
+    // last estimate was decided by it
+    bool cepstrum_enabled = METER_CEPSTRUM;
+    bool cepstrum_used = false;
+
+    // Remove mains ripple from input, and use low bins
+    bool mains_filter_enabled = METER_MAINS_FILTER;
+    MainsFilterTemplate<SAMPLE_RATE> mains_filter;
+
+    // Select decimation (zoom) by speed. If disabled, decimation_bits
+    // can be set manually via set_decimation().
+    bool decimation_enabled = METER_DECIMATION;
+    // Current decimation, 2^bits
+    uint8_t decimation_bits = 0;
+
+    // Use sliding DFT tracker between FFT runs
+    bool tracker_enabled = METER_TRACKER;
+    // true when last estimate was done by tracker
+    bool tracking = false;
+
+    // Use phase locked loop between FFT runs
+    bool pll_enabled = METER_PLL;
+    PllTrackerTemplate<SAMPLE_RATE, METER_PLL_BANDWIDTH> pll;
+
+    // Search FFT peak near the last one
+    bool band_search_enabled = METER_BAND_SEARCH;
+    // Peak bin of last FFT estimate (after harmonic check), 0 if not found
+    uint16_t peak_bin = 0;
+
+    // Profiling. Max work done by single tick(), in processed points
+    // (samples, bins or butterflies), ticks used by last FFT, and bins
+    // scanned by last peak search.
+    uint16_t max_tick_work = 0;
+    uint16_t fft_ticks = 0;
+    uint16_t scanned_bins = 0;
+
+    // FFT frames skipped, because of lost samples inside of window
+    uint32_t discarded_frames = 0;
+
+    void reset_state()
+    {
+        // Auto mode starts from full band
+        if (decimation_enabled) decimation_bits = 0;
+        restart();
+        mains_filter.reset();
+        pll.stop();
+    }
+
+    // Switch decimation (2^bits). History is restarted, because old
+    // samples have different rate.
+    void set_decimation(uint8_t bits)
+    {
+        decimation_bits = bits > METER_DECIMATION_MAX_BITS ? METER_DECIMATION_MAX_BITS : bits;
+        restart();
+    }
+
+    // Bin width with current decimation, Hz
+    fix16_t bin_hz() const
+    {
+        return BIN_HZ >> decimation_bits;
+    }
+
+    // Expected variance of last frequency (Hz^2), for regulator speed
+    // filter. Residual bias of peak interpolation (~ 1/8 bin) plus noise
+    // term, inverse to peak SNR. Loop & tracker estimates have jitter of
+    // the same order, so the last FFT peak is used for those too.
+    fix16_t variance() const
+    {
+        fix16_t bin = bin_hz();
+        fix16_t bin2 = fix16_mul(bin, bin);
+
+        if (!magnitude2) return fix16_maximum;
+
+        uint64_t ratio = ((uint64_t)noise.level << 16) / magnitude2;
+        if (ratio > fix16_one) ratio = fix16_one;
+
+        return fix16_mul(bin2, F16(1.0 / 64) + (fix16_t)ratio);
+    }
+
+    // First bin to search speed peak in
+    uint16_t skip_points() const
+    {
+        return treshold_bin(mains_filter_enabled ?
+            FFT_FILTERED_TRESHOLD_FREQUENCY : FFT_TRESHOLD_FREQUENCY);
+    }
+
+    // Store new sample. Cheap, call for every sample.
+    void consume(io_data_t &io_data)
+    {
+        skip_dropped(io_data.dropped);
+        consume_sample(io_data.current);
+    }
+
+    // Store block of samples from io, in one loop
+    void consume(const io_block_t &block)
+    {
+        skip_dropped(block.dropped);
+        for (uint16_t i = 0; i < IO_BLOCK_SIZE; i++) consume_sample(block.current[i]);
+    }
+
+    // Keep time of lost samples. History gets a gap.
+    void skip_dropped(uint16_t dropped)
+    {
+        if (!dropped) return;
+
+        clock += dropped;
+        if (dropped_samples < UINT16_MAX - dropped) dropped_samples += dropped;
+        else dropped_samples = UINT16_MAX;
+        contiguous_samples = 0;
+    }
+
+    void consume_sample(uint16_t current)
+    {
+        clock++;
+
+        uint16_t sample = mains_filter_enabled ? mains_filter.apply(current) : current;
+
+        // Loop works at full rate, not affected by decimation
+        if (pll.running)
+        {
+            pll.update(sample);
+            pll_collected++;
+        }
+
+        if (!decimator.apply(sample, sample)) return;
+
+        uint16_t dropped = history[history_head];
+
+        history[history_head++] = sample;
+        if (history_head >= SIZE) history_head = 0;
+
+        if (contiguous_samples < SIZE) contiguous_samples++;
+
+        if (collected < SIZE) collected++;
+        hop_collected++;
+
+        // Keep tracker bins in sync, including ones seeded in progress.
+        // Tracking is started after FFT only, so history is full and
+        // `dropped` is valid.
+        if (tracking || fft_step == FFT_STEP_SEED)
+        {
+            tracker.update(sample, dropped);
+            tracker_collected++;
+        }
+    }
+
+    // Do next step of speed estimation. Returns true when
+    // new frequency is available.
+    bool tick()
+    {
+        uint16_t work = 0;
+        bool ready = false;
+
+        // Loop & tracker estimates have priority, those are fast.
+        if (pll.running && pll_collected >= METER_PLL_HOP)
+        {
+            pll_collected = 0;
+            ready = pll_estimate();
+        }
+        else if (tracking && tracker_collected >= METER_TRACKER_HOP)
+        {
+            tracker_collected = 0;
+            ready = tracker_estimate();
+            // Worst case, with edge bin re-seed on bank shift
+            work = METER_TRACKER_BINS + SIZE;
+        }
+        else switch (fft_step)
+        {
+        case FFT_STEP_IDLE:
+        {
+            if (collected < SIZE) break;
+
+            uint16_t hop_size = tracking ? TRACKER_REFRESH : HOP_SIZE;
+
+            if (hop_collected >= hop_size)
+            {
+                hop_collected = 0;
+
+                // Spectrum of broken sequence has spurious lines, skip
+                // frame until gap leaves window
+                if (contiguous_samples < SIZE)
+                {
+                    discarded_frames++;
+                    break;
+                }
+
+                fft_ticks = 0;
+                fft_step = FFT_STEP_LOAD;
+            }
+            break;
+        }
+
+        case FFT_STEP_LOAD:
+            // Snapshot of history. After that, new samples can
+            // override history without FFT result corruption.
+            fft_load();
+            fft_clock = clock;
+            work = BUF_SIZE;
+            fft_step = FFT_STEP_PERMUTATE;
+            break;
+
+        case FFT_STEP_PERMUTATE:
+            fft_permutate(fft_buf, BUF_BITS);
+            work = BUF_SIZE;
+            fft_stride = 2;
+            fft_shift = TWIDDLE_BITS + 1;
+            fft_step = FFT_STEP_PASS;
+            break;
+
+        case FFT_STEP_PASS:
+            // Odd number of passes ends with radix-2 one
+            if (METER_FFT_RADIX4 && fft_stride * 2 <= BUF_SIZE)
+            {
+                fft_forward_pass_radix4(fft_buf, BUF_SIZE, fft_stride, fft_shift,
+                    Sine::table.data, TWIDDLE_BITS);
+                work = BUF_SIZE;
+                fft_stride <<= 2;
+                fft_shift -= 2;
+            }
+            else
+            {
+                fft_forward_pass(fft_buf, BUF_SIZE, fft_stride, fft_shift,
+                    Sine::table.data, TWIDDLE_BITS);
+                work = BUF_SIZE / 2;
+                fft_stride <<= 1;
+                fft_shift--;
+            }
+
+            if (fft_stride > BUF_SIZE)
+            {
+                fft_step = METER_REAL_FFT ? FFT_STEP_CONVERT : FFT_STEP_PEAK;
+            }
+            break;
+
+        case FFT_STEP_CONVERT:
+            fft_convert_table(fft_buf, BUF_BITS, false, false, Sine::table.data, TWIDDLE_BITS);
+            work = BUF_SIZE / 2;
+            fft_step = FFT_STEP_PEAK;
+            break;
+
+        case FFT_STEP_PEAK:
+            ready = fft_peak_estimate();
+            work = scanned_bins;
+            break;
+
+        case FFT_STEP_CEPSTRUM_LOG:
+            cepstrum_log();
+            work = SIZE / 2;
+            cepstrum_next = 0;
+            fft_step = FFT_STEP_CEPSTRUM_LAG;
+            break;
+
+        case FFT_STEP_CEPSTRUM_LAG:
+            ready = cepstrum_lag_step();
+            work = SIZE / 2;
+            break;
+
+        case FFT_STEP_SEED:
+            // Seed tracker bins one by one
+            tracker.seed_bin(tracker_seeded++, history, history_head);
+            work = SIZE;
+
+            if (tracker_seeded >= METER_TRACKER_BINS)
+            {
+                tracking = true;
+                tracker_collected = 0;
+                fft_step = FFT_STEP_IDLE;
+            }
+            break;
+        }
+
+        if (fft_step != FFT_STEP_IDLE) fft_ticks++;
+        if (work > max_tick_work) max_tick_work = work;
+
+        if (ready) rpm = (uint32_t)fix16_to_int(frequency) * 60 / MOTOR_POLES;
+
+        return ready;
+    }
+
+private:
+    typedef SineTableTemplate<TWIDDLE_BITS> Sine;
+    typedef WindowTemplate<FFT_BITS, WINDOW> Window;
+
+    // Half width of line lobe, bins. Main lobe of window + 1 for leakage
+    // of line between bins.
+    static constexpr uint16_t LOBE_BINS = WINDOW == WINDOW_BLACKMAN ? 4 :
+        (WINDOW == WINDOW_HANN ? 3 : 2);
+
+    // Jacobsen estimator correction for window
+    static constexpr fix16_t WINDOW_JACOBSEN_SCALE =
+        WINDOW == WINDOW_HANN ? F16(2) :
+        WINDOW == WINDOW_BLACKMAN ? F16(2.5) : fix16_one;
+
+    CicDecimatorTemplate<METER_CIC_ORDER, METER_DECIMATION_MAX_BITS> decimator;
+
+    // Circular history of last SIZE samples
+    uint16_t history[SIZE];
+    uint16_t history_head = 0;
+
+    // Number of valid samples in history (up to SIZE)
+    uint16_t collected = 0;
+    // New samples since last FFT start
+    uint16_t hop_collected = 0;
+
+    fft_complex_t fft_buf[BUF_SIZE];
+
+    MeterFftStep fft_step = FFT_STEP_IDLE;
+    uint16_t fft_stride;
+    uint16_t fft_shift;
+
+    SdftTrackerTemplate<FFT_BITS, METER_TRACKER_BINS, TWIDDLE_BITS> tracker;
+    // New samples since last tracker estimate
+    uint16_t tracker_collected = 0;
+    uint8_t tracker_seeded = 0;
+
+    // New samples since last loop estimate
+    uint16_t pll_collected = 0;
+
+    // Input sample clock, its value at FFT load, and samples lost since
+    // last estimate
+    uint32_t clock = 0;
+    uint32_t fft_clock = 0;
+    uint16_t dropped_samples = 0;
+    // History samples since the last gap (up to SIZE)
+    uint16_t contiguous_samples = 0;
+
+    // Band searches since last full scan
+    uint8_t band_frames = 0;
+    // Next cepstrum candidate to correlate
+    uint8_t cepstrum_next = 0;
+
+    // Max line & its sub-harmonics (1/d), with interpolated offset - fft_buf
+    // is overwritten by log spectrum. Bin 0 if candidate is not usable. Lag
+    // is interpolated max line position / d (Q8), harmonics of fractional
+    // spacing drift from integer lag.
+    struct CepstrumCandidate {
+        uint16_t bin;
+        fix16_t offset;
+        uint32_t power;
+        uint32_t lag;
+        int32_t correlation;
+    };
+    CepstrumCandidate cepstrum_candidates[METER_HARMONIC_MAX_DIVIDER];
+    int32_t cepstrum_mean = 0;
+
+    // Sample n of FFT window, scaled to FFT input
+    static fft_t fft_input(uint16_t sample, uint16_t n)
+    {
+        if (WINDOW == WINDOW_RECTANGULAR) return (fft_t)sample << INPUT_SHIFT;
+
+        return (fft_t)(Window::apply(sample, n) << (INPUT_SHIFT - Window::FRAC_BITS));
+    }
+
+    // Unroll history, from oldest to newest sample
+    void fft_load()
+    {
+#if METER_REAL_FFT
+        for (uint16_t i = 0; i < BUF_SIZE; i++)
+        {
+            uint16_t idx = (history_head + i * 2) & (SIZE - 1);
+            fft_buf[i] = {
+                .r = fft_input(history[idx], i * 2),
+                .i = fft_input(history[(idx + 1) & (SIZE - 1)], i * 2 + 1)
+            };
+        }
+#else
+        for (uint16_t i = 0; i < BUF_SIZE; i++)
+        {
+            uint16_t sample = history[(history_head + i) & (SIZE - 1)];
+            fft_buf[i] = { .r = fft_input(sample, i), .i = 0 };
+        }
+#endif
+    }
+
+    // Refine peak position with neighbour bins, returns offset from peak
+    // bin. `windowed` is false for tracker bins.
+    static fix16_t peak_offset(const fft_complex_t *peak, uint32_t peak_magnitude2, bool windowed)
+    {
+#if METER_PEAK_INTERPOLATION == METER_PEAK_INTERPOLATION_PARABOLIC
+        return peak_offset_parabolic(
+            bin_magnitude2(peak[-1]),
+            peak_magnitude2,
+            bin_magnitude2(peak[1])
+        );
+#elif METER_PEAK_INTERPOLATION == METER_PEAK_INTERPOLATION_JACOBSEN
+        return peak_offset_jacobsen(peak[-1], peak[0], peak[1],
+            windowed ? (fix16_t)WINDOW_JACOBSEN_SCALE : fix16_one);
+#else
+        return 0;
+#endif
+    }
+
+    // Calculate frequency from peak bin & its interpolated offset
+    void set_frequency(uint16_t bin, fix16_t offset, uint32_t peak_magnitude2)
+    {
+        frequency = fix16_mul(fix16_from_int(bin) + offset, BIN_HZ) >> decimation_bits;
+        magnitude2 = peak_magnitude2;
+    }
+
+    // Drop collected samples & spectrum state
+    void restart()
+    {
+        history_head = 0;
+        collected = 0;
+        hop_collected = 0;
+        contiguous_samples = 0;
+        tracker_collected = 0;
+        tracking = false;
+        fft_step = FFT_STEP_IDLE;
+        noise.reset();
+        decimator.set_bits(decimation_bits);
+        peak_bin = 0;
+    }
+
+    // Bin of given frequency (rounded up), with current decimation
+    uint16_t treshold_bin(uint32_t freq) const
+    {
+        return (uint16_t)(((freq * SIZE) << decimation_bits) / SAMPLE_RATE + 1);
+    }
+
+    // Max usable frequency for decimation 2^bits (1/4 of decimated rate)
+    static fix16_t band_limit(uint8_t bits)
+    {
+        return fix16_from_int(SAMPLE_RATE >> (bits + 2));
+    }
+
+    // Pick decimation for current speed. Returns true if changed (history
+    // is restarted then).
+    bool select_decimation(bool valid)
+    {
+        uint8_t bits = decimation_bits;
+
+        if (!valid) bits = 0;
+        else
+        {
+            // Speed went out of band => wider band
+            while (bits > 0 && frequency >= band_limit(bits)) bits--;
+            // Speed is well inside narrower band => zoom in
+            while (bits < METER_DECIMATION_MAX_BITS &&
+                frequency < band_limit(bits + 1) / 4 * 3) bits++;
+        }
+
+        if (bits == decimation_bits) return false;
+
+        set_decimation(bits);
+        return true;
+    }
+
+    // Max bin in [bin-1..bin+1]. Returns 0 if out of valid range.
+    uint16_t local_max(uint16_t bin)
+    {
+        if (bin <= skip_points() || bin + 1 >= SIZE/2 - 1) return 0;
+
+        uint16_t idx = bin - 1;
+        uint32_t max = bin_magnitude2(fft_buf[idx]);
+
+        for (uint16_t i = bin; i <= bin + 1; i++)
+        {
+            uint32_t magn2 = bin_magnitude2(fft_buf[i]);
+            if (magn2 > max) { max = magn2; idx = i; }
+        }
+
+        return idx;
+    }
+
+    // Power of spectrum line at bin. Line between bins leaks to neighbours,
+    // so the bigger neighbour is added, to make result position independent.
+    uint64_t line_power(uint16_t bin)
+    {
+        uint32_t prev = bin_magnitude2(fft_buf[bin - 1]);
+        uint32_t next = bin_magnitude2(fft_buf[bin + 1]);
+
+        return (uint64_t)bin_magnitude2(fft_buf[bin]) + (prev > next ? prev : next);
+    }
+
+    // Sum of fundamental & harmonics power. Harmonic position can drift
+    // because of fundamental rounding, so max of 3 bins is used.
+    uint64_t harmonic_score(uint16_t bin)
+    {
+        uint64_t score = line_power(bin);
+
+        for (uint8_t h = 2; h <= METER_HARMONICS; h++)
+        {
+            uint16_t idx = local_max(bin * h);
+
+            if (idx == 0) break;
+
+            score += line_power(idx);
+        }
+
+        return score;
+    }
+
+    // Find max & second line in [from..to). Noise floor is fed by full
+    // scans only, because band is mostly made of peak skirts. Bins are
+    // compared by search kernel (see bin_magnitude.h), `max` is exact.
+    void peak_scan(uint16_t from, uint16_t to, bool full,
+        uint32_t &max, uint32_t &max_idx, uint32_t &second)
+    {
+        max = 0;
+        max_idx = 0;
+        second = 0;
+
+        for (uint16_t i = from; i < to; i++)
+        {
+            uint32_t magn2 = bin_magnitude2_search(fft_buf[i]);
+
+            if (magn2 > max)
+            {
+                if (i > max_idx + LOBE_BINS) second = max;
+                max = magn2;
+                max_idx = i;
+            }
+            else if (magn2 > second && i > max_idx + LOBE_BINS) second = magn2;
+
+            if (full) noise.push(magn2);
+        }
+
+        scanned_bins += to - from;
+
+        if (METER_MAGNITUDE_KERNEL != METER_MAGNITUDE_EXACT && max)
+        {
+            // Keep second line ratio in kernel scale
+            uint32_t exact = bin_magnitude2(fft_buf[max_idx]);
+            second = (uint32_t)((uint64_t)second * exact / max);
+            max = exact;
+        }
+    }
+
+    // Half width of predicted band, bins. Lobe + margin + max speed
+    // change since last estimate. Loop & tracker estimates can be newer
+    // than FFT frame in progress, then there is no drift.
+    uint16_t band_half_width() const
+    {
+        int32_t since = (int32_t)(fft_clock - quality.timestamp);
+        uint64_t elapsed = since > 0 ? (uint64_t)since : 0;
+        uint64_t drift = ((uint64_t)METER_BAND_MAX_ACCEL * elapsed * SIZE << decimation_bits) /
+            ((uint64_t)SAMPLE_RATE * SAMPLE_RATE);
+
+        if (drift > SIZE/2) drift = SIZE/2;
+
+        return (uint16_t)(LOBE_BINS + METER_BAND_MARGIN_BINS + drift + 1);
+    }
+
+    // Last speed is good enough to search only near it
+    bool band_predictable() const
+    {
+        return band_search_enabled &&
+            peak_bin &&
+            frequency > 0 &&
+            band_frames < METER_BAND_FULL_SCAN - 1 &&
+            quality.trusted();
+    }
+
+    bool fft_peak_estimate()
+    {
+        fft_step = FFT_STEP_IDLE;
+
+        uint32_t max, max_idx;
+        // The second line, out of max lobe (+/- LOBE_BINS)
+        uint32_t second;
+
+        uint16_t first = skip_points();
+        uint16_t last = SIZE/2 - 1;
+        bool band = false;
+
+        scanned_bins = 0;
+
+        if (band_predictable())
+        {
+            // Last speed can come from tracker or loop, use it instead of
+            // last peak bin
+            uint16_t center = (uint16_t)(((uint64_t)frequency << decimation_bits) / BIN_HZ);
+            uint16_t half = band_half_width();
+            uint16_t from = center > first + half ? center - half : first;
+            uint16_t to = center + half + 1 < last ? center + half + 1 : last;
+
+            peak_scan(from, to, false, max, max_idx, second);
+
+            // Peak should be inside of band, not on its skirt
+            band = !noise.lost(max) &&
+                (max_idx >= (uint32_t)(from + LOBE_BINS) || from == first) &&
+                (max_idx + LOBE_BINS < (uint32_t)to || to == last);
+        }
+
+        if (band) band_frames++;
+        else
+        {
+            peak_scan(first, last, true, max, max_idx, second);
+            band_frames = 0;
+        }
+
+        bool valid = noise.check(max);
+        noise.update();
+
+        quality.second_peak = max ? (fix16_t)(((uint64_t)second << 16) / max) : 0;
+        set_quality(max, fft_clock, true);
+
+        // Mains ripple leftovers can be taken for speed
+        if (mains_filter_enabled && !mains_filter.settled) valid = false;
+
+        if (!valid)
+        {
+            frequency = 0;
+            rpm = 0;
+            magnitude2 = 0;
+            method = METER_METHOD_NONE;
+            confidence = 0;
+            quality.peak_to_noise = 0;
+            peak_bin = 0;
+            tracking = false;
+            pll.stop();
+            if (decimation_enabled) select_decimation(false);
+            return true;
+        }
+
+        method = METER_METHOD_FFT_PEAK;
+        confidence = fix16_one;
+
+        cepstrum_used = false;
+
+        if (harmonic_check)
+        {
+            uint16_t peak_idx = max_idx;
+            uint64_t best_score = harmonic_score(max_idx);
+            uint64_t next_score = 0;
+            uint64_t peak_power = line_power(max_idx);
+
+            for (uint8_t d = 2; d <= METER_HARMONIC_MAX_DIVIDER; d++)
+            {
+                uint16_t c = local_max((max_idx + d / 2) / d);
+
+                // Mains filter leaves some ripple on fast load changes. Its
+                // harmonics look like perfect series, so sub-harmonics are
+                // not searched below unfiltered treshold.
+                if (c == 0 || c < treshold_bin(FFT_TRESHOLD_FREQUENCY)) continue;
+
+                uint64_t score = harmonic_score(c);
+
+                // Weak candidates are not used, but still make
+                // result less confident.
+                if (score > best_score &&
+                    line_power(c) * METER_HARMONIC_MIN_RATIO >= peak_power)
+                {
+                    next_score = best_score;
+                    best_score = score;
+                    max = bin_magnitude2(fft_buf[c]);
+                    max_idx = c;
+                    method = METER_METHOD_HARMONIC;
+                }
+                else if (score > next_score) next_score = score;
+            }
+
+            confidence = next_score >= best_score ? 0 :
+                (fix16_t)(((best_score - next_score) << 16) / best_score);
+
+            if (cepstrum_enabled && method == METER_METHOD_FFT_PEAK &&
+                confidence < F16(METER_CEPSTRUM_CONFIDENCE) &&
+                cepstrum_start(peak_idx, peak_power))
+            {
+                return false;
+            }
+        }
+
+        return fft_peak_finish(max_idx, peak_offset(&fft_buf[max_idx], max, true), max);
+    }
+
+    // Save candidates (max line & its sub-harmonics), before fft_buf is
+    // reused for log spectrum. Returns false if there is nothing to choose
+    // from (no usable sub-harmonics).
+    bool cepstrum_start(uint16_t peak_idx, uint64_t peak_power)
+    {
+        bool found = false;
+        fix16_t offset = peak_offset_jacobsen(fft_buf[peak_idx - 1], fft_buf[peak_idx],
+            fft_buf[peak_idx + 1], WINDOW_JACOBSEN_SCALE);
+        uint32_t peak_q8 = (uint32_t)(((int32_t)peak_idx << 8) + (offset >> 8));
+
+        for (uint8_t d = 1; d <= METER_HARMONIC_MAX_DIVIDER; d++)
+        {
+            CepstrumCandidate &c = cepstrum_candidates[d - 1];
+            uint16_t bin = d == 1 ? peak_idx : local_max((peak_idx + d / 2) / d);
+
+            // The same limits as for harmonic check
+            if (d > 1 && (bin == 0 || bin < treshold_bin(FFT_TRESHOLD_FREQUENCY) ||
+                line_power(bin) * METER_HARMONIC_MIN_RATIO < peak_power)) bin = 0;
+
+            c.bin = bin;
+            c.lag = peak_q8 / d;
+            c.correlation = 0;
+            if (!bin) continue;
+
+            if (d > 1) found = true;
+            c.power = bin_magnitude2(fft_buf[bin]);
+            c.offset = peak_offset(&fft_buf[bin], c.power, true);
+        }
+
+        if (found) fft_step = FFT_STEP_CEPSTRUM_LOG;
+        return found;
+    }
+
+    // Log spectrum in place (.r), and its mean above skipped bins
+    void cepstrum_log()
+    {
+        uint16_t skip = skip_points();
+        int32_t sum = 0;
+
+        for (uint16_t k = skip; k < SIZE / 2; k++)
+        {
+            fft_buf[k].r = cepstrum_log2(bin_magnitude2_search(fft_buf[k]) | 1);
+            sum += fft_buf[k].r;
+        }
+
+        cepstrum_mean = sum / (SIZE / 2 - skip);
+    }
+
+    // Correlation of the next candidate. When all done - pick the result.
+    bool cepstrum_lag_step()
+    {
+        CepstrumCandidate &c = cepstrum_candidates[cepstrum_next];
+
+        if (c.bin)
+        {
+            c.correlation = cepstrum_correlation(fft_buf, skip_points(), SIZE / 2,
+                c.lag, cepstrum_mean);
+        }
+
+        if (++cepstrum_next < METER_HARMONIC_MAX_DIVIDER) return false;
+
+        return cepstrum_estimate();
+    }
+
+    // The densest comb, confirmed by correlation: the biggest divider,
+    // with correlation close to the best one (see cepstrum.h)
+    bool cepstrum_estimate()
+    {
+        fft_step = FFT_STEP_IDLE;
+
+        int32_t best = 0;
+
+        for (uint8_t d = 0; d < METER_HARMONIC_MAX_DIVIDER; d++)
+        {
+            int32_t correlation = cepstrum_candidates[d].correlation;
+            if (correlation > best) best = correlation;
+        }
+
+        uint8_t pick = 0;
+
+        for (uint8_t d = 1; d < METER_HARMONIC_MAX_DIVIDER; d++)
+        {
+            const CepstrumCandidate &c = cepstrum_candidates[d];
+            if (c.bin && c.correlation > 0 &&
+                c.correlation * METER_CEPSTRUM_MIN_RATIO >= best) pick = d;
+        }
+
+        const CepstrumCandidate &c = cepstrum_candidates[pick];
+
+        method = pick ? METER_METHOD_HARMONIC : METER_METHOD_FFT_PEAK;
+        cepstrum_used = true;
+
+        return fft_peak_finish(c.bin, c.offset, c.power);
+    }
+
+    // Report peak, and start loop / tracker from it
+    bool fft_peak_finish(uint16_t max_idx, fix16_t offset, uint32_t max)
+    {
+        set_frequency(max_idx, offset, max);
+        peak_bin = max_idx;
+
+        if (pll_enabled) pll_check();
+
+        // New band => new history, tracker can't be seeded
+        if (decimation_enabled && select_decimation(true)) return true;
+
+        // (Re)start tracking, if peak is far enough from spectrum edges.
+        // Re-seed also drops accumulated rounding errors of sliding DFT.
+        tracking = false;
+
+        if (tracker_enabled &&
+            max_idx >= (uint32_t)(skip_points() + METER_TRACKER_BINS / 2) &&
+            max_idx + METER_TRACKER_BINS / 2 < SIZE/2 - 1)
+        {
+            tracker.reset(max_idx - METER_TRACKER_BINS / 2);
+            tracker_seeded = 0;
+            fft_step = FFT_STEP_SEED;
+        }
+
+        return true;
+    }
+
+    // Compare loop with new FFT peak. Loop is (re)started, if it's not
+    // running or went away by more than 1 bin (slipped to other line).
+    // Locked loop is more smooth, so its frequency is reported instead of
+    // FFT one.
+    void pll_check()
+    {
+        fix16_t diff = pll.frequency() - frequency;
+
+        if (!pll.running || diff > bin_hz() || diff < -bin_hz())
+        {
+            pll.start(frequency);
+            pll_collected = 0;
+            return;
+        }
+
+        if (pll.locked)
+        {
+            frequency = pll.frequency();
+            method = METER_METHOD_PLL;
+        }
+    }
+
+    bool pll_estimate()
+    {
+        pll.refresh();
+
+        if (!pll.locked) return false;
+
+        frequency = pll.frequency();
+        method = METER_METHOD_PLL;
+        // Loop has no own SNR, keep the last FFT one
+        set_quality(magnitude2, clock, contiguous_samples >= SIZE);
+        return true;
+    }
+
+    // Update quality of new estimate, except second line (FFT only).
+    // Loop & tracker follow the window of history size.
+    void set_quality(uint32_t peak, uint32_t timestamp, bool contiguous)
+    {
+        uint64_t ratio = noise.level ? ((uint64_t)peak << 16) / noise.level : UINT64_MAX;
+
+        quality.peak_to_noise = ratio > (uint64_t)fix16_maximum ? fix16_maximum : (fix16_t)ratio;
+        quality.dropped = dropped_samples;
+        quality.contiguous = contiguous;
+        quality.timestamp = timestamp;
+        dropped_samples = 0;
+    }
+
+    bool tracker_estimate()
+    {
+        uint32_t max = 0;
+        uint8_t max_idx = 0;
+
+        for (uint8_t i = 0; i < METER_TRACKER_BINS; i++)
+        {
+            uint32_t magn2 = bin_magnitude2(tracker.bins[i]);
+
+            if (magn2 > max) { max = magn2; max_idx = i; }
+        }
+
+        uint16_t bin = tracker.first_bin + max_idx;
+
+        // Peak lost => fall back to FFT
+        if (noise.lost(max) ||
+            max_idx == 0 || max_idx == METER_TRACKER_BINS - 1 ||
+            bin - 1 < skip_points() || bin + 1 >= SIZE/2 - 1)
+        {
+            tracking = false;
+            if (fft_step == FFT_STEP_IDLE) hop_collected = HOP_SIZE;
+            return false;
+        }
+
+        set_frequency(bin, peak_offset(&tracker.bins[max_idx], max, false), max);
+        method = METER_METHOD_TRACKER;
+        set_quality(max, clock, contiguous_samples >= SIZE);
+
+        // Keep peak at bank center
+        int8_t shift = max_idx - METER_TRACKER_BINS / 2;
+        if (shift != 0) tracker.shift(shift, history, history_head);
+
+        return true;
+    }
+};
+
+#endif
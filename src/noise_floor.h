@@ -0,0 +1,122 @@
+#ifndef __NOISE_FLOOR_TEMPLATE__
+#define __NOISE_FLOOR_TEMPLATE__
+
+#include <stdint.h>
+
+// Online spectrum noise floor estimator & signal detector.
+//
+// Noise level is tracked as median of bins power. Median is not affected
+// by peak & its harmonics (those are a few bins of hundreds). Every frame,
+// level moves up or down by 1/2^TRACK_SHIFT, depending on how many bins are
+// above it. That's cheap (one compare per bin, done in peak search loop) and
+// slowly follows mains, temperature & brushes changes.
+//
+// Signal is valid, when peak/noise ratio (power) becomes above SNR_ON, and
+// stays valid until it falls below SNR_OFF. For pure noise, max of ~ 250
+// bins is ~ 8x above median, and probability to get 2^-N more is ~ 2^-N
+// per bin. So 24 gives false start once per hours, and 12 releases
+// signal in 1-2 frames after it's gone.
+//
+// MIN_LEVEL limits floor from below. Clean input (stopped motor) can have
+// median of ~ 0, and weak lines of interference would be treated as signal.
+//
+template <uint8_t TRACK_SHIFT = 4, uint8_t SNR_ON = 24, uint8_t SNR_OFF = 12, uint32_t MIN_LEVEL = 1>
+class NoiseFloorTemplate {
+
+public:
+    // Current noise floor (median bin power), integer part
+    uint32_t level = 0;
+    // Current signal state
+    bool valid = false;
+
+    void reset()
+    {
+        level = 0;
+        level_q = 0;
+        valid = false;
+        above = 0;
+        total = 0;
+        sum = 0;
+    }
+
+    // Add bin power of current frame
+    void push(uint32_t magn2)
+    {
+        if (magn2 > level) above++;
+        total++;
+        sum += magn2;
+    }
+
+    // Check peak power of current frame against noise floor, with
+    // hysteresis. Updates signal state.
+    bool check(uint32_t peak)
+    {
+        // Fast start from the first frame average
+        if (level_q == 0 && total) set_level_q((uint32_t)(sum / total) << FRAC);
+
+        valid = valid ? !lost(peak) : above_floor(peak, SNR_ON);
+        return valid;
+    }
+
+    // Check peak from other source (tracker), state is not changed.
+    bool lost(uint32_t peak) const
+    {
+        return !above_floor(peak, SNR_OFF);
+    }
+
+    // Move noise floor to median of current frame bins. Should be called
+    // after check(), to not mix peak frame into its own treshold.
+    void update()
+    {
+        if (!total) return;
+
+        // Jump fast, when most bins are above or below floor (noise level
+        // changed), and crawl near median.
+        uint32_t distance = above * 2 > total ? above * 8 / total : (total - above) * 8 / total;
+        uint8_t shift = distance >= 6 ? 1 : (distance >= 5 ? 2 : TRACK_SHIFT);
+        uint32_t step = (level_q >> shift) + 1;
+
+        if (above * 2 > total) set_level_q(level_q + step);
+        else set_level_q(level_q > step ? level_q - step : 0);
+
+        above = 0;
+        total = 0;
+        sum = 0;
+    }
+
+    // Peak/noise ratio (power), for debug
+    uint32_t snr(uint32_t peak) const
+    {
+        return (uint32_t)(((uint64_t)peak << FRAC) / floor_q());
+    }
+
+private:
+    // Level is tracked with fractional bits, to not jump between 0 and
+    // few units on quiet input.
+    static constexpr uint8_t FRAC = 4;
+
+    uint32_t level_q = 0;
+    uint16_t above = 0;
+    uint16_t total = 0;
+    uint64_t sum = 0;
+
+    void set_level_q(uint32_t val)
+    {
+        level_q = val;
+        level = val >> FRAC;
+    }
+
+    // Don't go below minimal level, to ignore weak interference lines
+    // when input is very clean
+    uint32_t floor_q() const
+    {
+        return level_q > (MIN_LEVEL << FRAC) ? level_q : (MIN_LEVEL << FRAC);
+    }
+
+    bool above_floor(uint32_t peak, uint8_t ratio) const
+    {
+        return ((uint64_t)peak << FRAC) >= (uint64_t)floor_q() * ratio;
+    }
+};
+
+#endif
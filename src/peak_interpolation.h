@@ -0,0 +1,87 @@
+#ifndef __PEAK_INTERPOLATION__
+#define __PEAK_INTERPOLATION__
+
+#include <stdint.h>
+#include "libfixmath/fix16.h"
+#include "fft.h"
+
+// Sub-bin spectral peak estimators. Use bins around max one to find
+// real peak position. Return offset from max bin (in bins), fix16 in
+// [-0.5..0.5] range.
+
+
+static inline uint64_t peak_abs64(int64_t val)
+{
+    return (uint64_t)(val < 0 ? -val : val);
+}
+
+static inline fix16_t peak_offset_clamp(fix16_t offset)
+{
+    if (offset > F16(0.5)) return F16(0.5);
+    if (offset < F16(-0.5)) return F16(-0.5);
+    return offset;
+}
+
+// Parabola via 3 points of magnitude^2. Cheap, but with rectangular window
+// has bias up to ~ 0.2 bin.
+//
+// offset = (next - prev) / (2 * (2*peak - prev - next))
+//
+static inline fix16_t peak_offset_parabolic(uint32_t prev, uint32_t peak, uint32_t next)
+{
+    int64_t numerator = (int64_t)next - prev;
+    int64_t denominator = ((int64_t)peak * 2 - prev - next) * 2;
+
+    if (denominator <= 0) return 0;
+
+    // Scale down to fit int32. Offset is a ratio, so scale does not matter.
+    while (denominator >= (1LL << 30))
+    {
+        numerator >>= 1;
+        denominator >>= 1;
+    }
+
+    return peak_offset_clamp(fix16_div((fix16_t)numerator, (fix16_t)denominator));
+}
+
+// Jacobsen estimator, uses complex bins. Almost exact for pure tone
+// with rectangular window.
+//
+// offset = scale * Re[(prev - next) / (2*peak - prev - next)]
+//
+// Window makes ratio smaller, and `scale` corrects that: 2 for Hann (exact),
+// 2.5 for Blackman (error < 0.001 bin).
+//
+static inline fix16_t peak_offset_jacobsen(
+    const fft_complex_t &prev,
+    const fft_complex_t &peak,
+    const fft_complex_t &next,
+    fix16_t scale = fix16_one)
+{
+    int64_t nr = (int64_t)prev.r - next.r;
+    int64_t ni = (int64_t)prev.i - next.i;
+    int64_t dr = (int64_t)peak.r * 2 - prev.r - next.r;
+    int64_t di = (int64_t)peak.i * 2 - prev.i - next.i;
+
+    // Scale down to 15 bits, to calculate products in 32 bits
+    uint64_t max = peak_abs64(nr);
+    if (peak_abs64(ni) > max) max = peak_abs64(ni);
+    if (peak_abs64(dr) > max) max = peak_abs64(dr);
+    if (peak_abs64(di) > max) max = peak_abs64(di);
+
+    uint8_t shift = 0;
+    while ((max >> shift) >= (1 << 15)) shift++;
+
+    int32_t nr32 = (int32_t)(nr >> shift), ni32 = (int32_t)(ni >> shift);
+    int32_t dr32 = (int32_t)(dr >> shift), di32 = (int32_t)(di >> shift);
+
+    // Re(N/D) = (Nr*Dr + Ni*Di) / (Dr^2 + Di^2)
+    int32_t numerator = nr32 * dr32 + ni32 * di32;
+    int32_t denominator = dr32 * dr32 + di32 * di32;
+
+    if (denominator == 0) return 0;
+
+    return peak_offset_clamp(fix16_mul(fix16_div(numerator, denominator), scale));
+}
+
+#endif
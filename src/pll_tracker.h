@@ -0,0 +1,175 @@
+#ifndef __PLL_TRACKER_TEMPLATE__
+#define __PLL_TRACKER_TEMPLATE__
+
+#include <stdint.h>
+#include "libfixmath/fix16.h"
+#include "sine_table.h"
+
+constexpr double PLL_TRACKER_PI = 3.14159265358979323846;
+
+// Biggest shift with 2^shift <= val
+constexpr uint8_t pll_tracker_log2(uint32_t val)
+{
+    return val <= 1 ? 0 : 1 + pll_tracker_log2(val >> 1);
+}
+
+// Phase locked loop, follows single line (motor commutation ripple) at
+// sample rate. Started by FFT estimate, and gives smooth frequency between
+// FFT frames.
+//
+//   x(n) -> DC removal -> * e^(-j*phase) -> 2 x LPF -> I, Q
+//   error = Q / |I, Q|                     (sin of phase error)
+//   step += Ki * error                     (frequency, integrator)
+//   phase += step + Kp * error
+//
+// Type 2 loop (no static phase error on constant frequency, follows ramps
+// with small lag), damping 0.707. Gains are calculated at compile time
+// from natural frequency (BANDWIDTH, Hz):
+//
+//   Kp = 2 * zeta * wn / Fs, Ki = (wn / Fs)^2
+//
+// Wider band => faster lock & reaction to speed change, but more jitter
+// from noise and neighbour lines. Mixer low-pass is ~ 4x wider than loop,
+// to not add much delay into loop.
+//
+// Error is normalized by amplitude, so loop gain does not depend on line
+// level. Division is done once per refresh(), not per sample.
+//
+// Loop is locked, when phase error stays below ~ 30 degrees long enough
+// (LOCK_SAMPLES, ~ 2 / BANDWIDTH). Unlocked loop should not be used, meter
+// falls back to FFT then.
+//
+template <uint32_t SAMPLE_RATE, uint16_t BANDWIDTH = 20>
+class PllTrackerTemplate {
+
+public:
+    static constexpr double WN = 2 * PLL_TRACKER_PI * BANDWIDTH / SAMPLE_RATE;
+
+    // Kp, Ki in units of phase (2^32 per turn), for error in Q16 radians.
+    // Ki has 16 more fractional bits (as frequency step).
+    static constexpr int32_t KP = (int32_t)(2 * 0.707 * WN * 65536 / (2 * PLL_TRACKER_PI) + 0.5);
+    static constexpr int64_t KI = (int64_t)(WN * WN * 4294967296.0 / (2 * PLL_TRACKER_PI) + 0.5);
+
+    // Mixer low-pass, 2 x one pole, cutoff Fs / (2*PI*2^shift) >= 4 * BANDWIDTH
+    static constexpr uint8_t LPF_SHIFT = pll_tracker_log2(
+        (uint32_t)(SAMPLE_RATE / (2 * PLL_TRACKER_PI * 4 * BANDWIDTH)));
+
+    static constexpr uint32_t LOCK_SAMPLES = 2 * SAMPLE_RATE / BANDWIDTH;
+
+    static_assert(KP > 0 && LPF_SHIFT > 0, "PLL bandwidth is too wide for sample rate");
+
+    bool running = false;
+    bool locked = false;
+
+    // Start from given frequency, with unknown phase
+    void start(fix16_t freq)
+    {
+        step = ((int64_t)freq << 32) / SAMPLE_RATE;
+        phase = 0;
+        i1 = q1 = i2 = q2 = 0;
+        dc = 0;
+        dc_seeded = false;
+        score = 0;
+        locked = false;
+        // No correction until the first refresh()
+        inv_amplitude = 0;
+        running = true;
+    }
+
+    void stop()
+    {
+        running = false;
+        locked = false;
+    }
+
+    // Add new sample (ADC scale). Called for every sample.
+    void update(uint16_t sample)
+    {
+        if (!dc_seeded)
+        {
+            dc = (int32_t)sample << (DC_BITS + INPUT_SHIFT);
+            dc_seeded = true;
+        }
+
+        int32_t x = ((int32_t)sample << INPUT_SHIFT) - (dc >> DC_BITS);
+        dc += x >> (DC_SHIFT - DC_BITS);
+
+        // Mix to 0Hz, Q14 cos/sin
+        int32_t c = Sine::fastcos(phase) >> 17;
+        int32_t s = Sine::fastsin(phase) >> 17;
+
+        int32_t mi = (x * c) >> 14;
+        int32_t mq = -(x * s) >> 14;
+
+        i1 += ((mi << LPF_BITS) - i1) >> LPF_SHIFT;
+        q1 += ((mq << LPF_BITS) - q1) >> LPF_SHIFT;
+        i2 += (i1 - i2) >> LPF_SHIFT;
+        q2 += (q1 - q2) >> LPF_SHIFT;
+
+        // Phase error (sin), Q16 radians
+        int32_t error = (int32_t)(((int64_t)q2 * inv_amplitude) >> 16);
+        if (error > fix16_one) error = fix16_one;
+        if (error < -fix16_one) error = -fix16_one;
+
+        step += KI * error;
+        phase += (uint32_t)(step >> 16) + (uint32_t)(KP * error);
+
+        // Lock detector. In phase & small error => score goes up. Random
+        // phase (noise, other line) gives mostly negative score.
+        if (i2 > 0 && (q2 < 0 ? -q2 : q2) < i2)
+        {
+            if (score < LOCK_SAMPLES) score++;
+            else locked = true;
+        }
+        else
+        {
+            score = score > 1 ? score - 1 : 0;
+            if (score < LOCK_SAMPLES / 2) locked = false;
+        }
+    }
+
+    // Update amplitude normalization. Should be called periodically
+    // (every ~ 1ms is enough, amplitude changes slowly).
+    void refresh()
+    {
+        uint32_t ai = (uint32_t)(i2 < 0 ? -i2 : i2);
+        uint32_t aq = (uint32_t)(q2 < 0 ? -q2 : q2);
+
+        // |I, Q| ~ max + min / 2 (error < 12%)
+        uint32_t amplitude = ai > aq ? ai + aq / 2 : aq + ai / 2;
+        if (amplitude < 1) amplitude = 1;
+
+        uint64_t inv = ((uint64_t)1 << 32) / amplitude;
+        inv_amplitude = inv > UINT32_MAX ? UINT32_MAX : (uint32_t)inv;
+    }
+
+    // Current frequency, Hz
+    fix16_t frequency() const
+    {
+        return (fix16_t)((step * SAMPLE_RATE) >> 32);
+    }
+
+private:
+    typedef SineTableTemplate<8> Sine;
+
+    // Input scale up, and extra bits of DC & LPF states
+    static constexpr uint8_t INPUT_SHIFT = 4;
+    static constexpr uint8_t DC_BITS = 4;
+    // DC removal cutoff ~ Fs / (2*PI*2^shift) ~ 10 Hz
+    static constexpr uint8_t DC_SHIFT = 8;
+    static constexpr uint8_t LPF_BITS = 8;
+
+    // NCO phase (2^32 per turn) & step per sample (16 fractional bits)
+    uint32_t phase = 0;
+    int64_t step = 0;
+
+    int32_t dc = 0;
+    bool dc_seeded = false;
+
+    int32_t i1 = 0, q1 = 0, i2 = 0, q2 = 0;
+    uint32_t inv_amplitude = 0;
+
+    uint32_t score = 0;
+};
+
+#endif
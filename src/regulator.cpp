@@ -12,6 +12,29 @@ void Regulator::enable()
     enabled = true;
     adrc_freq_estimated = 0;
     adrc_correction = 0;
+    power_out = 0;
+    speed_filter.reset();
+}
+
+// New meter estimate, with its variance (Hz^2) & quality check result
+void Regulator::measure(fix16_t freq, fix16_t variance, bool trusted)
+{
+    if (REGULATOR_QUALITY_GATE && !trusted && freq != 0) return;
+
+    freq_in = freq;
+    if (speed_filter_enabled) speed_filter.update(freq, variance);
+}
+
+// Switch speed filter at runtime (for A/B compare). Filter is not run
+// while off, so it restarts from the last measured speed.
+void Regulator::set_speed_filter(bool on)
+{
+    if (on && !speed_filter_enabled)
+    {
+        speed_filter.reset();
+        speed_filter.frequency = freq_in;
+    }
+    speed_filter_enabled = on;
 }
 
 // Calculate internal observers parameters L1, L2
@@ -46,8 +69,22 @@ void Regulator::tick()
 {
     if (!enabled) return;
 
+    if (speed_filter_enabled)
+    {
+        // Move speed filter by motor model, y' = b0 * u + f (the same as
+        // ADRC observers use), with output & disturbance of previous tick.
+        fix16_t model_rate = fix16_div(power_out, adrc_b0_inv) + adrc_correction;
+        speed_filter.predict(
+            fix16_mul(fix16_mul(model_rate, integr_coeff), freq_max),
+            F16(REGULATOR_SPEED_FILTER_Q)
+        );
+    }
+
     // Normalize frequency to [0.0 ... 1.0]
-    fix16_t freq_norm = fix16_mul(fix16_from_int(freq_in), freq_norm_coeff);
+    fix16_t freq_norm = fix16_mul(
+        speed_filter_enabled ? speed_filter.frequency : freq_in,
+        freq_norm_coeff
+    );
 
     // 1-st order ADRC by https://arxiv.org/pdf/1908.04596.pdf (augmented)
 
@@ -107,6 +144,7 @@ void Regulator::configure()
     float _rpm_max = eeprom_float_read(CFG_RPM_MAX_ADDR, CFG_RPM_MAX_DEFAULT);
 
     freq_norm_coeff = fix16_from_float(1.0f / (_rpm_max * MOTOR_POLES / 60));
+    freq_max = fix16_from_float(_rpm_max * MOTOR_POLES / 60);
 
     cfg_freq_max_limit_norm = F16(0.8);
 
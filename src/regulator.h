@@ -3,6 +3,7 @@
 
 #include "libfixmath/fix16.h"
 #include "config.h"
+#include "speed_kalman.h"
 
 // ADRC iteration frequency, Hz. To fit math in fix16 without overflow.
 // Observers in ADRC system must have performance much higher
@@ -16,12 +17,37 @@
 // Coefficient used by ADRC observers integrators
 constexpr fix16_t integr_coeff = F16(1.0 / APP_ADRC_FREQUENCY);
 
+// Feed ADRC with Kalman filtered speed (meter estimates + motor model),
+// instead of the last meter estimate. See speed_kalman.h.
+#ifndef REGULATOR_SPEED_FILTER
+#define REGULATOR_SPEED_FILTER 0
+#endif
+
+// Skip untrusted meter estimates (noisy peak, close second line, lost
+// samples), keep the last good speed instead. Zero speed (no signal) is
+// always passed. Off by default: at high speed motor current has a real
+// neighbour line, and ~ 40% of good estimates are not trusted, so speed
+// would be stale too often. Estimate variance still weights those in
+// speed filter.
+#ifndef REGULATOR_QUALITY_GATE
+#define REGULATOR_QUALITY_GATE 0
+#endif
+
+// Speed filter model error change per regulator tick, (Hz per tick)^2.
+// More => follows measurements faster, less => smoother.
+#ifndef REGULATOR_SPEED_FILTER_Q
+#define REGULATOR_SPEED_FILTER_Q 1
+#endif
+
 class Regulator
 {
 public:
-    // Measured frequency.
+    // Measured frequency (Hz).
     // We use frequency instead of RPM, because it better fits into fix16_t.
-    uint32_t freq_in = 0;
+    fix16_t freq_in = 0;
+
+    // Filtered speed, valid when speed filter is enabled
+    SpeedKalman speed_filter;
 
     // For callibrator only. Normalized frequency setpoint for direct control
     // from calibrator. Updated by apply_knob() in normal case.
@@ -46,6 +72,8 @@ public:
     void disable();
     void enable();
     void tick();
+    void measure(fix16_t freq, fix16_t variance, bool trusted = true);
+    void set_speed_filter(bool on);
     void configure();
     void apply_knob(fix16_t knob);
     void adrc_update_observers_parameters();
@@ -53,6 +81,9 @@ public:
 private:
     bool enabled = false;
 
+    // Use speed filter, see set_speed_filter()
+    bool speed_filter_enabled = REGULATOR_SPEED_FILTER;
+
     // Config limits are now in normalized [0.0..1.0] form of max motor frequency.
     fix16_t cfg_freq_max_limit_norm;
     fix16_t cfg_freq_min_limit_norm;
@@ -60,6 +91,9 @@ private:
     // Frequency normalization scale, convert to range [0.0 ... 1.0]
     // Calculated on config load
     fix16_t freq_norm_coeff = F16(1.0f / MOTOR_MAX_RPM_LIMIT);
+    // Reverse of above, Hz. Normalization coeff is too small for precise
+    // conversion back.
+    fix16_t freq_max = F16(MOTOR_MAX_RPM_LIMIT * MOTOR_POLES / 60);
 
     // Cache for knob normalization, calculated on config load
     fix16_t knob_norm_coeff = F16(1);
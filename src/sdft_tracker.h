@@ -0,0 +1,124 @@
+#ifndef __SDFT_TRACKER_TEMPLATE__
+#define __SDFT_TRACKER_TEMPLATE__
+
+#include <stdint.h>
+#include "fft.h"
+#include "sine_table.h"
+
+// Sliding DFT for small bank of bins around tracked peak. Window is the
+// last 2^WINDOW_BITS samples (the same as FFT uses). Every new sample
+// updates bank in O(BINS), so speed can be estimated much more often than
+// full FFT allows.
+//
+// S(n) = (S(n-1) + x(n) - x(n-N)) * e^(j*2*PI*k/N)
+//
+// Bins have the same scale as Meter's FFT output, so magnitudes tresholds
+// and peak interpolation are compatible. Rotators are taken from sine table
+// with 2^TWIDDLE_BITS points per quadrant.
+//
+template <uint8_t WINDOW_BITS, uint8_t BINS = 5, uint8_t TWIDDLE_BITS = WINDOW_BITS - 2>
+class SdftTrackerTemplate {
+
+public:
+    // Index of first bin in bank
+    uint16_t first_bin = 0;
+
+    fft_complex_t bins[BINS];
+
+    // Set bank position. Bins should be seeded after that.
+    void reset(uint16_t first)
+    {
+        first_bin = first;
+    }
+
+    // Calculate bin from scratch, via direct DFT. Bins can be seeded one by
+    // one, while new samples come - update() keeps seeded ones in sync.
+    // History is circular, `head` points to the oldest sample.
+    void seed_bin(uint8_t i, const uint16_t history[], uint16_t head)
+    {
+        uint16_t k = first_bin + i;
+        int64_t acc_r = 0;
+        int64_t acc_i = 0;
+
+        for (uint16_t n = 0; n < WINDOW_SIZE; n++)
+        {
+            int32_t x = history[(head + n) & (WINDOW_SIZE - 1)];
+            uint32_t pos = phase(k * n);
+
+            acc_r += (int64_t)x * Sine::fastcos(pos);
+            acc_i -= (int64_t)x * Sine::fastsin(pos);
+        }
+
+        bins[i].r = (int32_t)(acc_r >> (31 - INPUT_SHIFT));
+        bins[i].i = (int32_t)(acc_i >> (31 - INPUT_SHIFT));
+
+        rotators[i].r = Sine::fastcos(phase(k));
+        rotators[i].i = Sine::fastsin(phase(k));
+    }
+
+    // Add new sample, and remove one, dropped from window.
+    void update(uint16_t sample_in, uint16_t sample_out)
+    {
+        int32_t diff = ((int32_t)sample_in - sample_out) << INPUT_SHIFT;
+
+        for (uint8_t i = 0; i < BINS; i++)
+        {
+            int32_t r = bins[i].r + diff;
+            int32_t im = bins[i].i;
+            int32_t wr = rotators[i].r;
+            int32_t wi = rotators[i].i;
+
+            bins[i].r = (int32_t)(((int64_t)r * wr - (int64_t)im * wi + ROUNDING) >> 31);
+            bins[i].i = (int32_t)(((int64_t)r * wi + (int64_t)im * wr + ROUNDING) >> 31);
+        }
+    }
+
+    // Move bank 1 bin up (+1) or down (-1). New edge bin is calculated
+    // from scratch.
+    void shift(int8_t direction, const uint16_t history[], uint16_t head)
+    {
+        if (direction > 0)
+        {
+            for (uint8_t i = 0; i < BINS - 1; i++)
+            {
+                bins[i] = bins[i + 1];
+                rotators[i] = rotators[i + 1];
+            }
+            first_bin++;
+            seed_bin(BINS - 1, history, head);
+        }
+        else
+        {
+            for (uint8_t i = BINS - 1; i > 0; i--)
+            {
+                bins[i] = bins[i - 1];
+                rotators[i] = rotators[i - 1];
+            }
+            first_bin--;
+            seed_bin(0, history, head);
+        }
+    }
+
+private:
+    static const uint16_t WINDOW_SIZE = 1 << WINDOW_BITS;
+
+    // Scale to match real FFT output: X(k) * 2^16 / N
+    static const uint8_t INPUT_SHIFT = 16 - WINDOW_BITS;
+
+    static const int64_t ROUNDING = 1LL << 30;
+
+    static_assert(WINDOW_BITS <= TWIDDLE_BITS + 2, "Sine table is too small for this window");
+
+    typedef SineTableTemplate<TWIDDLE_BITS> Sine;
+
+    // e^(j*2*PI*k/N) for each bin
+    fft_complex_t rotators[BINS];
+
+    // Angle 2*PI*idx/N => sine table position
+    static uint32_t phase(uint32_t idx)
+    {
+        return idx << (32 - WINDOW_BITS);
+    }
+};
+
+#endif
@@ -0,0 +1,69 @@
+#ifndef __SINE_TABLE_TEMPLATE__
+#define __SINE_TABLE_TEMPLATE__
+
+#include <stdint.h>
+
+// Taylor series of sin(x), precise enough for [0..PI/2]
+constexpr double sine_table_taylor(double x)
+{
+    double term = x;
+    double sum = x;
+
+    for (uint8_t k = 1; k < 16; k++)
+    {
+        term *= -x * x / ((2 * k) * (2 * k + 1));
+        sum += term;
+    }
+
+    return sum;
+}
+
+// Table values, 2^BITS + 1 points
+template <uint8_t BITS>
+struct SineTableData {
+    int32_t data[(1 << BITS) + 1];
+
+    constexpr SineTableData() : data()
+    {
+        for (uint32_t n = 0; n <= (1 << BITS); n++)
+        {
+            double x = n * 3.14159265358979323846 / (2 << BITS);
+            // Truncate, as original SYLT-FFT generator does
+            int64_t v = (int64_t)(sine_table_taylor(x) * 2147483648.0);
+            data[n] = v > 2147483647 ? 2147483647 : (int32_t)v;
+        }
+    }
+};
+
+// First quadrant of sine wave, 2^BITS + 1 points, Q31 (1 is limited to
+// 0x7FFFFFFF). The same format as SYLT-FFT sinetable[], but generated at
+// compile time, for any size.
+//
+// More bits => more precise twiddles / rotators (and more flash used).
+// FFT of 2^N real points needs BITS >= N - 2.
+//
+template <uint8_t BITS>
+class SineTableTemplate {
+
+public:
+    static constexpr SineTableData<BITS> table{};
+
+    // Sin by table lookup, without interpolation (as SYLT-FFT fastsin).
+    // pos = 00000000 to FFFFFFFF, corresponding to 0-2PI(less one)
+    static int32_t fastsin(uint32_t pos)
+    {
+        uint32_t index = (pos & 0x40000000) ? 0x40000000 - (pos & 0x3fffffff) : (pos & 0x3fffffff);
+        int32_t sample = table.data[index >> (32 - 2 - BITS)];
+        return pos & 0x80000000 ? -sample : sample;
+    }
+
+    static int32_t fastcos(uint32_t pos)
+    {
+        return fastsin(pos + 0x40000000);
+    }
+};
+
+template <uint8_t BITS>
+constexpr SineTableData<BITS> SineTableTemplate<BITS>::table;
+
+#endif
@@ -0,0 +1,101 @@
+#ifndef __SPEED_KALMAN__
+#define __SPEED_KALMAN__
+
+#include <stdint.h>
+#include "libfixmath/fix16.h"
+
+// Kalman filter for motor speed. Fuses meter estimates (irregular, ~ 60
+// per second for FFT, with noise of a few Hz) with motor model prediction
+// from regulator (every regulator tick).
+//
+// State is speed `f` & model error `d` (speed change per tick, not
+// explained by model - mismatch of b0, slow ADRC disturbance observer):
+//
+//   predict:  f += df + d,    P = F * P * F' + [0 0; 0 Q],  F = [1 1; 0 1]
+//   update:   K = P[.][0] / (P00 + R),  [f d] += K * (z - f),  P -= K * P[0][.]
+//
+// R is measurement variance, reported by meter for every estimate (depends
+// on bin width & peak SNR). So weak peaks move estimate less than good ones.
+// Q is how fast model error can change per tick.
+//
+// All values are in Hz and Hz^2 (per tick), to keep precision of fix16.
+// Normalized speed variance (~ 1e-6) does not fit it.
+//
+class SpeedKalman
+{
+public:
+    // Upper limit of variance. Keeps fix16 math in range, and means
+    // "unknown" (the next measurement is taken as is).
+    static constexpr fix16_t MAX_VARIANCE = F16(10000);
+    // Initial model error variance, (Hz per tick)^2
+    static constexpr fix16_t INITIAL_ERROR_VARIANCE = F16(100);
+
+    // Filtered frequency (Hz), model error (Hz per tick)
+    fix16_t frequency = 0;
+    fix16_t model_error = 0;
+
+    // Covariance, [f d] x [f d]
+    fix16_t p00 = MAX_VARIANCE;
+    fix16_t p01 = 0;
+    fix16_t p11 = INITIAL_ERROR_VARIANCE;
+
+    void reset()
+    {
+        frequency = 0;
+        model_error = 0;
+        p00 = MAX_VARIANCE;
+        p01 = 0;
+        p11 = INITIAL_ERROR_VARIANCE;
+    }
+
+    // Move estimate by model (Hz per tick), q - model error change
+    // variance per tick, (Hz per tick)^2
+    void predict(fix16_t delta, fix16_t q)
+    {
+        frequency += delta + model_error;
+        if (frequency < 0) frequency = 0;
+
+        // Sums are done in 64 bits, each term can be near the limit
+        p00 = clamp((int64_t)p00 + 2 * (int64_t)p01 + p11);
+        p01 = clamp((int64_t)p01 + p11);
+        p11 = clamp((int64_t)p11 + q);
+    }
+
+    // Apply measurement z (Hz) with variance r (Hz^2)
+    void update(fix16_t z, fix16_t r)
+    {
+        // No signal (motor stopped or line lost) - nothing to fuse with
+        if (z == 0)
+        {
+            reset();
+            return;
+        }
+
+        if (r < 1) r = 1;
+        if (r > MAX_VARIANCE) r = MAX_VARIANCE;
+
+        fix16_t s = p00 + r;
+        fix16_t k0 = fix16_div(p00, s);
+        fix16_t k1 = fix16_div(p01, s);
+
+        fix16_t innovation = z - frequency;
+
+        frequency += fix16_mul(k0, innovation);
+        model_error += fix16_mul(k1, innovation);
+
+        p11 -= fix16_mul(k1, p01);
+        p00 -= fix16_mul(k0, p00);
+        p01 -= fix16_mul(k0, p01);
+    }
+
+private:
+    // Covariance p01 can be negative, its magnitude is limited the same way
+    static fix16_t clamp(int64_t v)
+    {
+        if (v > MAX_VARIANCE) return MAX_VARIANCE;
+        if (v < -MAX_VARIANCE) return -MAX_VARIANCE;
+        return (fix16_t)v;
+    }
+};
+
+#endif
@@ -0,0 +1,76 @@
+#ifndef __WINDOW_TEMPLATE__
+#define __WINDOW_TEMPLATE__
+
+#include <stdint.h>
+#include "sine_table.h"
+
+// FFT window types
+#define WINDOW_RECTANGULAR 0
+#define WINDOW_HANN 1
+#define WINDOW_BLACKMAN 2
+
+// Main lobe half width (to first zero) / highest side lobe:
+//
+// - Rectangular: 1 bin,  -13dB, side lobes fall 6dB per octave
+// - Hann:        2 bins, -31dB, side lobes fall 18dB per octave
+// - Blackman:    3 bins, -58dB, side lobes fall 18dB per octave
+
+
+// cos(2*PI*n/N) for n in [0..N/2]
+constexpr double window_cos(uint32_t n, uint32_t size)
+{
+    return sine_table_taylor(3.14159265358979323846 / 2 - 2 * 3.14159265358979323846 * n / size);
+}
+
+// Window value, normalized to coherent gain 1 (sum of coefficients = N).
+// So tone gives the same peak magnitude as with rectangular window.
+constexpr double window_value(uint8_t type, uint32_t n, uint32_t size)
+{
+    return type == WINDOW_HANN ?
+        (0.5 - 0.5 * window_cos(n, size)) / 0.5 :
+        type == WINDOW_BLACKMAN ?
+            (0.42 - 0.5 * window_cos(n, size) +
+                0.08 * (2 * window_cos(n, size) * window_cos(n, size) - 1)) / 0.42 :
+            1.0;
+}
+
+// Half of symmetric (periodic) window, 2^BITS / 2 + 1 points, Q14
+template <uint8_t BITS, uint8_t TYPE>
+struct WindowData {
+    uint16_t data[(1 << (BITS - 1)) + 1];
+
+    constexpr WindowData() : data()
+    {
+        for (uint32_t n = 0; n <= (1u << (BITS - 1)); n++)
+        {
+            double v = window_value(TYPE, n, 1 << BITS) * 16384 + 0.5;
+            data[n] = v < 0 ? 0 : (uint16_t)v;
+        }
+    }
+};
+
+// Window of 2^BITS points. Coefficients are calculated at compile time and
+// stored in flash (half of window, it's symmetric). Applied with one integer
+// multiply per sample.
+//
+template <uint8_t BITS, uint8_t TYPE>
+class WindowTemplate {
+
+public:
+    static constexpr uint16_t SIZE = 1 << BITS;
+    static constexpr uint8_t FRAC_BITS = 14;
+
+    // Blackman peak is 2.38 (with coherent gain correction), fits uint16
+    static constexpr WindowData<BITS, TYPE> table{};
+
+    // Sample * window[n], Q14. 12-bit sample gives up to 28 bits.
+    static uint32_t apply(uint16_t sample, uint16_t n)
+    {
+        return (uint32_t)sample * table.data[n <= SIZE / 2 ? n : SIZE - n];
+    }
+};
+
+template <uint8_t BITS, uint8_t TYPE>
+constexpr WindowData<BITS, TYPE> WindowTemplate<BITS, TYPE>::table;
+
+#endif
@@ -0,0 +1,376 @@
+#ifndef __ZERO_CROSSING_METER_TEMPLATE__
+#define __ZERO_CROSSING_METER_TEMPLATE__
+
+#include <stdint.h>
+#include "libfixmath/fix16.h"
+#include "io.h"
+#include "config.h"
+#include "sine_table.h"
+#include "mains_filter.h"
+#include "meter_quality.h"
+
+#ifndef METER_MAINS_FILTER
+#define METER_MAINS_FILTER 1
+#endif
+
+// Band-pass quality. More => better noise & ripple rejection, but slower
+// settling (~ Q/PI periods) and more steps to sweep speed range.
+#ifndef ZC_METER_Q
+#define ZC_METER_Q 8
+#endif
+
+// Periods, used for single estimate (moving window, updated on every
+// period). More => less jitter, but slower reaction.
+#ifndef ZC_METER_PERIODS
+#define ZC_METER_PERIODS 8
+#endif
+
+// Range of measured frequency, Hz
+#define ZC_METER_MIN_FREQUENCY 150
+#define ZC_METER_MAX_FREQUENCY 5000
+
+// Min filtered amplitude to count crossings, ADC LSB
+#ifndef ZC_METER_MIN_AMPLITUDE
+#define ZC_METER_MIN_AMPLITUDE 4
+#endif
+
+
+// Time-domain speed meter, alternative to FFT one (select with
+// METER_ENGINE). The same interface: consume() every sample, tick() in
+// main loop, result in `frequency`.
+//
+//   ADC -> mains filter -> band-pass biquad -> zero crossings -> periods
+//
+// - Band-pass is 2nd order IIR (constant 0dB peak gain), centered at last
+//   estimate. Motor line is 20-40dB below ripple & brushes noise, wide band
+//   would see noise only. Narrow band makes motor line close to sine.
+// - While not locked, band center sweeps speed range in 1/8 steps, and
+//   waits on each step for LOCK_PERIODS good periods.
+// - Rising zero crossings are detected with hysteresis (1/4 of filtered
+//   amplitude), and positioned between samples by linear interpolation.
+// - Frequency is calculated on every period (not frame), from the time
+//   of last ZC_METER_PERIODS periods.
+// - Periods should be consistent (1/8 of average). Noise after band-pass
+//   looks like tone with random phase jumps, and breaks the sequence.
+//   Single break restarts collection, no good periods for HOLD_SAMPLES
+//   => line is lost, sweep starts again.
+//
+// Cost is 3 multiplies per sample (biquad) + mains filter, and 3 divisions
+// per period. No buffers (~ 300 bytes of RAM with mains filter), no FFT
+// tables.
+//
+// Downside - only one line can pass band-pass. If other line (mains
+// harmonic, neighbour) is close and not much weaker, periods get jitter
+// from beats. FFT separates such lines by bins. Also, sweep takes 1-3s
+// to find line, FFT needs one frame.
+//
+template <uint32_t SAMPLE_RATE>
+class ZeroCrossingMeterTemplate
+{
+public:
+    // Biquad coefficients scale
+    static constexpr uint8_t COEFF_BITS = 14;
+    // Input is scaled up to keep precision of filter state
+    static constexpr uint8_t INPUT_SHIFT = 2;
+    // Crossing time fractional bits
+    static constexpr uint8_t TIME_BITS = 8;
+
+    static constexpr uint8_t PERIODS = ZC_METER_PERIODS;
+
+    static constexpr uint32_t MAX_PERIOD = SAMPLE_RATE / ZC_METER_MIN_FREQUENCY;
+    static constexpr uint32_t MIN_PERIOD = SAMPLE_RATE / ZC_METER_MAX_FREQUENCY;
+    // Keep lock without good periods, ~ 50ms
+    static constexpr uint32_t HOLD_SAMPLES = SAMPLE_RATE / 20;
+    // Consistent periods in a row, required to lock. Noise in narrow band
+    // can give a window of good periods, but not three in a row.
+    static constexpr uint16_t LOCK_PERIODS = 3 * PERIODS;
+    // Sweep step time, in periods of band center. Filter settling + lock.
+    static constexpr uint32_t DWELL_PERIODS = ZC_METER_Q / 2 + LOCK_PERIODS;
+
+    // Detected frequency (Hz) & RPM
+    fix16_t frequency = 0;
+    uint32_t rpm = 0;
+
+    // Filtered signal amplitude (peak envelope), ADC LSB, for debug
+    uint32_t amplitude = 0;
+
+    // Band-pass locked on motor line
+    bool locked = false;
+
+    // Quality of last estimate. Band-pass has no noise floor & passes one
+    // line only, so estimate, passed periods consistency check, gets
+    // minimal trusted SNR and no second line.
+    MeterQuality quality;
+
+    // Remove mains ripple from input
+    bool mains_filter_enabled = METER_MAINS_FILTER;
+    MainsFilterTemplate<SAMPLE_RATE> mains_filter;
+
+    // Profiling. Breaks of periods sequence while locked, since reset
+    uint32_t glitches = 0;
+
+    ZeroCrossingMeterTemplate() { reset_state(); }
+
+    void reset_state()
+    {
+        frequency = 0;
+        rpm = 0;
+        amplitude = 0;
+        glitches = 0;
+        locked = false;
+        quality = MeterQuality();
+        dropped_samples = 0;
+        contiguous_samples = 0;
+        x1 = x2 = y1 = y2 = 0;
+        envelope = 0;
+        armed = false;
+        clock = 0;
+        last_crossing = 0;
+        last_valid = 0;
+        head = 0;
+        run = 0;
+        ready = false;
+        mains_filter.reset();
+        tune(ZC_METER_MIN_FREQUENCY);
+    }
+
+    // Expected variance of last frequency (Hz^2), for regulator speed
+    // filter. Jitter on records is ~ 0.4% RMS (1/256).
+    fix16_t variance() const
+    {
+        fix16_t sigma = (frequency >> 8) + fix16_one;
+        return fix16_mul(sigma, sigma);
+    }
+
+    // Filter sample & check crossing. Cheap, call for every sample.
+    void consume(io_data_t &io_data)
+    {
+        skip_dropped(io_data.dropped);
+        consume_sample(io_data.current);
+    }
+
+    // Store block of samples from io, in one loop
+    void consume(const io_block_t &block)
+    {
+        skip_dropped(block.dropped);
+        for (uint16_t i = 0; i < IO_BLOCK_SIZE; i++) consume_sample(block.current[i]);
+    }
+
+    // Keep time of lost samples. Filter state is broken by gap.
+    void skip_dropped(uint16_t dropped)
+    {
+        if (!dropped) return;
+
+        clock += dropped;
+        if (dropped_samples < UINT16_MAX - dropped) dropped_samples += dropped;
+        else dropped_samples = UINT16_MAX;
+        contiguous_samples = 0;
+    }
+
+    void consume_sample(uint16_t current)
+    {
+        uint16_t sample = mains_filter_enabled ? mains_filter.apply(current) : current;
+
+        // Band-pass has zero at DC, no need to remove offset
+        int32_t x = (int32_t)sample << INPUT_SHIFT;
+
+        int32_t y = (b0 * (x - x2) - a1 * y1 - a2 * y2) >> COEFF_BITS;
+
+        x2 = x1; x1 = x;
+        int32_t prev = y1;
+        y2 = y1; y1 = y;
+
+        clock++;
+        if (contiguous_samples < UINT16_MAX) contiguous_samples++;
+
+        // Peak envelope, decays with ~ 16ms time constant
+        uint32_t abs_y = (uint32_t)(y < 0 ? -y : y) << ENVELOPE_BITS;
+        if (abs_y > envelope) envelope = abs_y;
+        else envelope -= envelope >> 8;
+
+        int32_t hysteresis = (int32_t)(envelope >> (ENVELOPE_BITS + 2));
+
+        if (y < -hysteresis) armed = true;
+        else if (armed && y >= 0)
+        {
+            armed = false;
+
+            if (envelope >= (ZC_METER_MIN_AMPLITUDE << (INPUT_SHIFT + ENVELOPE_BITS)))
+            {
+                // Crossing point between samples, linear interpolation.
+                // prev < 0 <= y here, frac is distance back from current one.
+                uint32_t frac = ((uint32_t)y << TIME_BITS) / (uint32_t)(y - prev);
+                crossing((clock << TIME_BITS) - frac);
+            }
+        }
+    }
+
+    // Calculate estimate for last period, or move sweep. Returns true when
+    // new frequency is available (~ once per period).
+    bool tick()
+    {
+        if (locked && clock - last_valid > HOLD_SAMPLES)
+        {
+            // Line lost, search from the start
+            locked = false;
+            run = 0;
+            ready = false;
+            tune(ZC_METER_MIN_FREQUENCY);
+
+            frequency = 0;
+            rpm = 0;
+            quality.peak_to_noise = 0;
+            return true;
+        }
+
+        if (!locked && clock - tuned_at > dwell)
+        {
+            uint32_t next = center + (center >> 3);
+            tune(next > ZC_METER_MAX_FREQUENCY ? ZC_METER_MIN_FREQUENCY : next);
+            return false;
+        }
+
+        if (!ready) return false;
+        ready = false;
+
+        uint32_t span = times[head] - times[(head + 1) % (PERIODS + 1)];
+
+        fix16_t f = (fix16_t)((((uint64_t)PERIODS * SAMPLE_RATE) << (16 + TIME_BITS)) / span);
+        uint32_t hz = (uint32_t)fix16_to_int(f);
+
+        amplitude = envelope >> (INPUT_SHIFT + ENVELOPE_BITS);
+
+        // In sweep, line should be inside band. Otherwise, that's slope
+        // of band-pass response, or line of the next step.
+        if (!locked)
+        {
+            if (hz > center + (center >> 3) || hz < center - (center >> 3)) return false;
+            locked = true;
+        }
+
+        last_valid = clock;
+        frequency = f;
+        rpm = hz * 60 / MOTOR_POLES;
+
+        quality.peak_to_noise = F16(METER_QUALITY_MIN_SNR);
+        quality.dropped = dropped_samples;
+        // Periods window is measured on filter output, gap should be older
+        quality.contiguous = contiguous_samples >= (span >> TIME_BITS);
+        quality.timestamp = clock;
+        dropped_samples = 0;
+
+        // Follow line with band-pass center. Retune only on noticeable
+        // change, that takes a division.
+        if (hz > center + (center >> 4) || hz < center - (center >> 4)) tune(hz);
+
+        return true;
+    }
+
+private:
+    typedef SineTableTemplate<8> Sine;
+
+    // Biquad coefficients (COEFF_BITS) & state
+    int32_t b0 = 0, a1 = 0, a2 = 0;
+    int32_t x1 = 0, x2 = 0, y1 = 0, y2 = 0;
+
+    // Band center (Hz), tune time & sweep step time (samples)
+    uint32_t center = 0;
+    uint32_t tuned_at = 0;
+    uint32_t dwell = 0;
+
+    // Envelope has fractional bits, to decay smoothly down to 0
+    static constexpr uint8_t ENVELOPE_BITS = 8;
+    uint32_t envelope = 0;
+    bool armed = false;
+
+    // Sample counter & crossing times, TIME_BITS fractional bits.
+    // Overflow is fine, only differences are used.
+    uint32_t clock = 0;
+    uint32_t last_crossing = 0;
+    uint32_t last_valid = 0;
+    // Last crossing times (ring, `head` is the newest) & number of
+    // consistent periods in a row
+    uint32_t times[PERIODS + 1];
+    uint8_t head = 0;
+    uint16_t run = 0;
+
+    // Full window of periods collected
+    bool ready = false;
+
+    // Samples lost since last estimate, and samples since the last gap
+    uint16_t dropped_samples = 0;
+    uint16_t contiguous_samples = 0;
+
+    // RBJ band-pass (0dB peak gain):
+    //
+    //   w = 2*PI*f/Fs, alpha = sin(w) / (2*Q)
+    //   b0 = alpha / (1 + alpha), b1 = 0, b2 = -b0
+    //   a1 = -2*cos(w) / (1 + alpha), a2 = (1 - alpha) / (1 + alpha)
+    //
+    void tune(uint32_t freq)
+    {
+        center = freq;
+        tuned_at = clock;
+        dwell = DWELL_PERIODS * SAMPLE_RATE / freq;
+
+        uint32_t pos = (uint32_t)(((uint64_t)freq << 32) / SAMPLE_RATE);
+
+        // Q31 => fix16
+        fix16_t sin_w = Sine::fastsin(pos) >> 15;
+        fix16_t cos_w = Sine::fastcos(pos) >> 15;
+
+        fix16_t alpha = sin_w / (2 * ZC_METER_Q);
+        fix16_t norm = fix16_div(fix16_one, fix16_one + alpha);
+
+        b0 = fix16_mul(alpha, norm) >> (16 - COEFF_BITS);
+        a1 = -fix16_mul(cos_w * 2, norm) >> (16 - COEFF_BITS);
+        a2 = fix16_mul(fix16_one - alpha, norm) >> (16 - COEFF_BITS);
+    }
+
+    void crossing(uint32_t time)
+    {
+        uint32_t period = time - last_crossing;
+        last_crossing = time;
+
+        if (period < (MIN_PERIOD << TIME_BITS) || period > (MAX_PERIOD << TIME_BITS))
+        {
+            restart(time);
+            return;
+        }
+
+        // Check period against average of collected ones. Big
+        // difference => noise or other line, start over.
+        if (run)
+        {
+            uint32_t n = run > PERIODS ? PERIODS : run;
+            uint32_t span = times[head] - times[(head + PERIODS + 1 - n) % (PERIODS + 1)];
+            uint32_t avg = span / n;
+
+            uint32_t diff = period > avg ? period - avg : avg - period;
+
+            if (diff > (avg >> 3))
+            {
+                restart(time);
+                return;
+            }
+        }
+
+        head = head >= PERIODS ? 0 : head + 1;
+        times[head] = time;
+        if (run < UINT16_MAX) run++;
+
+        if (run >= (locked ? PERIODS : LOCK_PERIODS)) ready = true;
+    }
+
+    // Start periods collection from this crossing
+    void restart(uint32_t time)
+    {
+        if (locked) glitches++;
+        head = 0;
+        times[0] = time;
+        run = 0;
+        ready = false;
+    }
+};
+
+#endif
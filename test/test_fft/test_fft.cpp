@@ -0,0 +1,240 @@
+#ifdef UNIT_TEST
+
+#include <unity.h>
+
+#include <stdio.h>
+#include <math.h>
+#include <time.h>
+
+#include "fft.h"
+
+// Compare real-input FFT pipeline (512 real points, packed to 256 complex)
+// with plain 512 points complex FFT, used before.
+
+#define SIZE 512
+#define SIZE_BITS 9
+
+static uint16_t samples[SIZE];
+static fft_complex_t complex_buf[SIZE];
+static fft_complex_t real_buf[SIZE / 2];
+
+// Mix of 2 tones + DC, 12 bits ADC scale
+static void fill_samples(float bin1, float bin2)
+{
+    for (int i = 0; i < SIZE; i++)
+    {
+        float val = 2000
+            + 1000 * sinf(2 * M_PI * bin1 * i / SIZE)
+            + 300 * cosf(2 * M_PI * bin2 * i / SIZE + 0.3f);
+        samples[i] = (uint16_t)val;
+    }
+}
+
+static void complex_fft()
+{
+    for (int i = 0; i < SIZE; i++) complex_buf[i] = { .r = (fft_t)samples[i] << 16, .i = 0 };
+    fft_fft(complex_buf, SIZE_BITS);
+}
+
+// Real FFT result is 4x bigger, use 2 bits less for input
+static void real_fft()
+{
+    for (int i = 0; i < SIZE / 2; i++)
+    {
+        real_buf[i] = { .r = (fft_t)samples[i * 2] << 14, .i = (fft_t)samples[i * 2 + 1] << 14 };
+    }
+    fft_fftr(real_buf, SIZE_BITS - 1);
+}
+
+static uint32_t magnitude2(fft_complex_t &bin)
+{
+    uint32_t acc0 = (uint32_t) (((int64_t)bin.r * bin.r ) >> 33);
+    uint32_t acc1 = (uint32_t) (((int64_t)bin.i * bin.i ) >> 33);
+    return acc0 + acc1;
+}
+
+void test_real_fft_error() {
+    fill_samples(37.3f, 100);
+    complex_fft();
+    real_fft();
+
+    // Max error vs biggest bin
+    int32_t max_bin = 0;
+    int32_t max_err = 0;
+
+    for (int i = 1; i < SIZE / 2; i++)
+    {
+        int32_t err_r = abs(complex_buf[i].r - real_buf[i].r);
+        int32_t err_i = abs(complex_buf[i].i - real_buf[i].i);
+
+        if (err_r > max_err) max_err = err_r;
+        if (err_i > max_err) max_err = err_i;
+        if (abs(complex_buf[i].r) > max_bin) max_bin = abs(complex_buf[i].r);
+        if (abs(complex_buf[i].i) > max_bin) max_bin = abs(complex_buf[i].i);
+    }
+
+    printf("Real vs complex FFT: max error %d of %d (%.6f%%)\n",
+        max_err, max_bin, max_err * 100.0f / max_bin);
+
+    // Not bit-exact (different rounding order), but error is far below
+    // of FFT resolution.
+    TEST_ASSERT_LESS_THAN(max_bin / 1000, max_err);
+}
+
+void test_real_fft_peak() {
+    for (float bin = 16; bin < SIZE / 2 - 16; bin += 3.7f)
+    {
+        fill_samples(bin, bin / 3);
+        complex_fft();
+        real_fft();
+
+        uint32_t complex_max = 0, real_max = 0;
+        int complex_idx = 0, real_idx = 0;
+
+        for (int i = 1; i < SIZE / 2; i++)
+        {
+            uint32_t m = magnitude2(complex_buf[i]);
+            if (m > complex_max) { complex_max = m; complex_idx = i; }
+
+            m = magnitude2(real_buf[i]);
+            if (m > real_max) { real_max = m; real_idx = i; }
+        }
+
+        TEST_ASSERT_EQUAL_INT(complex_idx, real_idx);
+        TEST_ASSERT_UINT32_WITHIN(complex_max / 100, complex_max, real_max);
+    }
+}
+
+// Same as complex_fft() / real_fft(), but by radix-4 passes.
+// 512 points have odd number of passes (the last one is radix-2),
+// 256 points - even.
+static fft_complex_t radix4_buf[SIZE];
+
+static void complex_fft_radix4()
+{
+    for (int i = 0; i < SIZE; i++) radix4_buf[i] = { .r = (fft_t)samples[i] << 16, .i = 0 };
+    fft_permutate(radix4_buf, SIZE_BITS);
+    fft_forward_radix4(radix4_buf, SIZE_BITS);
+}
+
+static void real_fft_radix4()
+{
+    for (int i = 0; i < SIZE / 2; i++)
+    {
+        radix4_buf[i] = { .r = (fft_t)samples[i * 2] << 14, .i = (fft_t)samples[i * 2 + 1] << 14 };
+    }
+    fft_permutate(radix4_buf, SIZE_BITS - 1);
+    fft_forward_radix4(radix4_buf, SIZE_BITS - 1);
+    fft_convert(radix4_buf, SIZE_BITS - 1, false, false);
+}
+
+// Max error of radix-4 result vs radix-2 one, relative to the biggest bin
+static float radix4_error(fft_complex_t *ref, int size)
+{
+    int32_t max_bin = 0;
+    int32_t max_err = 0;
+
+    for (int i = 1; i < size; i++)
+    {
+        int32_t err_r = abs(ref[i].r - radix4_buf[i].r);
+        int32_t err_i = abs(ref[i].i - radix4_buf[i].i);
+
+        if (err_r > max_err) max_err = err_r;
+        if (err_i > max_err) max_err = err_i;
+        if (abs(ref[i].r) > max_bin) max_bin = abs(ref[i].r);
+        if (abs(ref[i].i) > max_bin) max_bin = abs(ref[i].i);
+    }
+
+    return (float)max_err / max_bin;
+}
+
+void test_radix4_error() {
+    fill_samples(37.3f, 100);
+
+    complex_fft();
+    complex_fft_radix4();
+    float complex_err = radix4_error(complex_buf, SIZE / 2);
+
+    real_fft();
+    real_fft_radix4();
+    float real_err = radix4_error(real_buf, SIZE / 2);
+
+    printf("Radix-4 vs radix-2 FFT: max error %.6f%% (complex %d), %.6f%% (real %d)\n",
+        complex_err * 100, SIZE, real_err * 100, SIZE);
+
+    // Only rounding differs
+    TEST_ASSERT_LESS_THAN_FLOAT(1e-5f, complex_err);
+    TEST_ASSERT_LESS_THAN_FLOAT(1e-5f, real_err);
+}
+
+void test_radix4_peak() {
+    for (float bin = 16; bin < SIZE / 2 - 16; bin += 3.7f)
+    {
+        fill_samples(bin, bin / 3);
+        real_fft();
+        real_fft_radix4();
+
+        uint32_t radix2_max = 0, radix4_max = 0;
+        int radix2_idx = 0, radix4_idx = 0;
+
+        for (int i = 1; i < SIZE / 2; i++)
+        {
+            uint32_t m = magnitude2(real_buf[i]);
+            if (m > radix2_max) { radix2_max = m; radix2_idx = i; }
+
+            m = magnitude2(radix4_buf[i]);
+            if (m > radix4_max) { radix4_max = m; radix4_idx = i; }
+        }
+
+        TEST_ASSERT_EQUAL_INT(radix2_idx, radix4_idx);
+        TEST_ASSERT_UINT32_WITHIN(radix2_max / 10000 + 1, radix2_max, radix4_max);
+    }
+}
+
+#define BENCHMARK_LOOPS 20000
+
+void test_benchmark() {
+    fill_samples(37.3f, 100);
+
+    clock_t start = clock();
+    for (int i = 0; i < BENCHMARK_LOOPS; i++) complex_fft();
+    float complex_time = (float)(clock() - start) / CLOCKS_PER_SEC;
+
+    start = clock();
+    for (int i = 0; i < BENCHMARK_LOOPS; i++) real_fft();
+    float real_time = (float)(clock() - start) / CLOCKS_PER_SEC;
+
+    start = clock();
+    for (int i = 0; i < BENCHMARK_LOOPS; i++) complex_fft_radix4();
+    float complex_radix4_time = (float)(clock() - start) / CLOCKS_PER_SEC;
+
+    start = clock();
+    for (int i = 0; i < BENCHMARK_LOOPS; i++) real_fft_radix4();
+    float real_radix4_time = (float)(clock() - start) / CLOCKS_PER_SEC;
+
+    printf("Complex FFT %d: %.2f us, buffer %u bytes\n",
+        SIZE, complex_time * 1e6f / BENCHMARK_LOOPS, (unsigned)sizeof(complex_buf));
+    printf("Real FFT %d: %.2f us, buffer %u bytes\n",
+        SIZE, real_time * 1e6f / BENCHMARK_LOOPS, (unsigned)sizeof(real_buf));
+    printf("Complex FFT %d, radix-4: %.2f us\n",
+        SIZE, complex_radix4_time * 1e6f / BENCHMARK_LOOPS);
+    printf("Real FFT %d, radix-4: %.2f us\n",
+        SIZE, real_radix4_time * 1e6f / BENCHMARK_LOOPS);
+}
+
+
+void setUp(void) {}
+void tearDown(void) {}
+
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_real_fft_error);
+    RUN_TEST(test_real_fft_peak);
+    RUN_TEST(test_radix4_error);
+    RUN_TEST(test_radix4_peak);
+    RUN_TEST(test_benchmark);
+    return UNITY_END();
+}
+
+#endif
@@ -0,0 +1,410 @@
+#ifdef UNIT_TEST
+
+#include <unity.h>
+
+#include <stdio.h>
+#include <math.h>
+#include <time.h>
+#include <stdlib.h>
+
+#include "app_hal.h"
+#include "io.h"
+#include "meter.h"
+
+// Fake DMA buffer, the same layout as on MCU: 2 halves of interleaved
+// (current, knob) pairs. With software oversampling, ADC_OVERSAMPLE pairs
+// (conversions) make one sample.
+
+#define FETCH_PER_TICK ADC_FETCH_PER_TICK
+#define CHANNELS 2
+#define HALF_SIZE (FETCH_PER_TICK * CHANNELS)
+
+static volatile uint16_t dma_buf[HALF_SIZE * 2];
+
+static void dma_fill(uint32_t half, uint16_t current_base, uint16_t knob)
+{
+    for (uint32_t i = 0; i < FETCH_PER_TICK; i++)
+    {
+        dma_buf[half * HALF_SIZE + i * CHANNELS] = current_base + i / ADC_OVERSAMPLE;
+        dma_buf[half * HALF_SIZE + i * CHANNELS + 1] = knob;
+    }
+}
+
+// What HAL does in DMA interrupts
+static void dma_half_done(Io &io, uint32_t half)
+{
+    io.consume(
+        { &dma_buf[half * HALF_SIZE], CHANNELS },
+        { &dma_buf[half * HALF_SIZE + 1], CHANNELS }
+    );
+}
+
+void test_strided_view() {
+    dma_fill(0, 100, 7);
+    dma_fill(1, 200, 9);
+
+    adc_view_t current = { &dma_buf[HALF_SIZE], CHANNELS };
+    adc_view_t knob = { &dma_buf[HALF_SIZE + 1], CHANNELS };
+
+    for (uint8_t i = 0; i < FETCH_PER_TICK; i++)
+    {
+        TEST_ASSERT_EQUAL_UINT16(200 + i / ADC_OVERSAMPLE, current[i]);
+        TEST_ASSERT_EQUAL_UINT16(9, knob[i]);
+    }
+
+    // View reads DMA memory directly, new data is visible without copy
+    dma_buf[HALF_SIZE + 2] = 555;
+    TEST_ASSERT_EQUAL_UINT16(555, current[1]);
+}
+
+// Main loop takes all blocks, checks samples order, returns samples count
+static uint32_t take_blocks(Io &io, uint16_t &expected, uint16_t dropped = 0)
+{
+    uint32_t taken = 0;
+    io_block_t block;
+
+    while (io.out.pop(block))
+    {
+        TEST_ASSERT_EQUAL_UINT16(taken ? 0 : dropped, block.dropped);
+        expected += block.dropped;
+
+        for (uint32_t i = 0; i < IO_BLOCK_SIZE; i++)
+        {
+            TEST_ASSERT_EQUAL_UINT16(expected++, block.current[i]);
+        }
+
+        taken += IO_BLOCK_SIZE;
+    }
+
+    return taken;
+}
+
+void test_consume_halves() {
+    static Io io;
+    uint16_t expected = 1000;
+
+    // Ping-pong: while one half is consumed, DMA fills another
+    for (uint32_t n = 0; n < 20; n++)
+    {
+        uint32_t half = n & 1;
+        dma_fill(half, 1000 + n * IO_BLOCK_SIZE, 4095);
+        dma_half_done(io, half);
+
+        TEST_ASSERT_EQUAL_UINT32(IO_BLOCK_SIZE, take_blocks(io, expected));
+    }
+
+    TEST_ASSERT_EQUAL_UINT16(1000 + 20 * IO_BLOCK_SIZE, expected);
+
+    // Interrupt only accumulates knob, value comes from low rate task
+    TEST_ASSERT_EQUAL_INT32(0, io.knob);
+    io.knob_tick();
+    TEST_ASSERT_EQUAL_INT32(fix16_one, io.knob);
+
+    // Main loop is in time, nothing lost
+    TEST_ASSERT_EQUAL_UINT32(20, io.stats.blocks);
+    TEST_ASSERT_EQUAL_UINT32(0, io.stats.overruns);
+    TEST_ASSERT_EQUAL_UINT8(1, io.stats.high_water);
+}
+
+void test_consume_overflow() {
+    static Io io;
+
+    // Main loop is late: queue fills up, the rest is lost
+    uint32_t halves = IO_QUEUE_BLOCKS + 2;
+
+    for (uint32_t n = 0; n < halves; n++)
+    {
+        dma_fill(n & 1, n * IO_BLOCK_SIZE, 0);
+        dma_half_done(io, n & 1);
+    }
+
+    uint16_t expected = 0;
+    uint32_t taken = take_blocks(io, expected);
+    uint32_t lost = halves * IO_BLOCK_SIZE - taken;
+
+    TEST_ASSERT_EQUAL_UINT32(IO_QUEUE_BLOCKS * IO_BLOCK_SIZE, taken);
+
+    // The next block carries the number of lost samples
+    dma_fill(halves & 1, halves * IO_BLOCK_SIZE, 0);
+    dma_half_done(io, halves & 1);
+
+    TEST_ASSERT_EQUAL_UINT32(IO_BLOCK_SIZE, take_blocks(io, expected, lost));
+
+    // Stats show the same
+    TEST_ASSERT_EQUAL_UINT32(IO_QUEUE_BLOCKS + 1, io.stats.blocks);
+    TEST_ASSERT_EQUAL_UINT32(2, io.stats.overruns);
+    TEST_ASSERT_EQUAL_UINT32(lost, io.stats.dropped);
+    TEST_ASSERT_EQUAL_UINT8(IO_QUEUE_BLOCKS, io.stats.high_water);
+
+    printf("Queue: %u samples taken, %u lost, %u overruns, high water %u blocks\n",
+        taken, lost, io.stats.overruns, io.stats.high_water);
+}
+
+//
+// Knob task. Noisy knob should give steady output, follow moves without
+// lag, and reach both ends of scale.
+//
+
+#define KNOB_NOISE 20
+
+static uint32_t knob_seed;
+
+// Feed halves for ms with noisy knob, then run knob task
+static void knob_run_ms(Io &io, uint32_t ms, uint16_t knob)
+{
+    uint32_t halves = SAMPLING_RATE / IO_BLOCK_SIZE * ms / 1000;
+
+    for (uint32_t n = 0; n < halves; n++)
+    {
+        for (uint32_t i = 0; i < FETCH_PER_TICK; i++)
+        {
+            knob_seed = knob_seed * 1664525 + 1013904223;
+            int32_t noise = (int32_t)((knob_seed >> 16) % (2 * KNOB_NOISE + 1)) - KNOB_NOISE;
+            int32_t val = knob + noise;
+
+            dma_buf[(n & 1) * HALF_SIZE + i * CHANNELS + 1] = (uint16_t)(val < 0 ? 0 : val > 4095 ? 4095 : val);
+        }
+
+        dma_half_done(io, n & 1);
+        io_block_t block;
+        while (io.out.pop(block)) {}
+    }
+
+    hal::set_timestamp(hal::get_timestamp() + ms);
+    io.knob_tick();
+}
+
+void test_knob_task() {
+    static Io io;
+
+    hal::setup();
+    knob_seed = 1;
+
+    // Steady knob: output does not jitter
+    knob_run_ms(io, KNOB_PERIOD_MS, 2000);
+
+    uint32_t changes = 0;
+    fix16_t prev = io.knob;
+
+    for (uint32_t ms = 0; ms < 2000; ms += KNOB_PERIOD_MS)
+    {
+        knob_run_ms(io, KNOB_PERIOD_MS, 2000);
+        if (io.knob != prev) changes++;
+        prev = io.knob;
+    }
+
+    TEST_ASSERT_EQUAL_UINT32(0, changes);
+    TEST_ASSERT_INT32_WITHIN(F16(KNOB_HYSTERESIS) + 2, 2000 << 4, io.knob);
+
+    // Step: settles to 1% of scale within 200 ms
+    uint32_t settle_ms = 0;
+
+    while (settle_ms < 1000)
+    {
+        knob_run_ms(io, KNOB_PERIOD_MS, 3000);
+        settle_ms += KNOB_PERIOD_MS;
+        if (abs(io.knob - (3000 << 4)) <= fix16_one / 100) break;
+    }
+
+    TEST_ASSERT_LESS_THAN(200, settle_ms);
+
+    // Ends of scale are reached exactly
+    for (uint32_t ms = 0; ms < 300; ms += KNOB_PERIOD_MS) knob_run_ms(io, KNOB_PERIOD_MS, 10);
+    TEST_ASSERT_EQUAL_INT32(0, io.knob);
+
+    for (uint32_t ms = 0; ms < 300; ms += KNOB_PERIOD_MS) knob_run_ms(io, KNOB_PERIOD_MS, 4090);
+    TEST_ASSERT_EQUAL_INT32(fix16_one, io.knob);
+
+    printf("Knob: %u output changes on steady noisy input, step settles in %u ms\n",
+        changes, settle_ms);
+}
+
+//
+// Handoff throughput: per sample queue entries (as before) vs blocks, alone
+// and with FFT meter consume (as main loop does). On MCU per sample way
+// also costs interrupt entry per sample, not counted here.
+//
+
+#define HANDOFF_BENCHMARK_SAMPLES 2000000
+
+// Old way: every sample (with knob) is pushed & popped separately
+static etl::queue_spsc_atomic<io_data_t, 10, etl::memory_model::MEMORY_MODEL_SMALL> sample_queue;
+static fix16_t sample_knob = 0;
+
+static void __attribute__((noinline)) sample_isr(const adc_view_t &adc_current, const adc_view_t &adc_knob)
+{
+    sample_knob = uint16_t((sample_knob * 15 + adc_knob[0]) >> 4);
+
+    io_data_t io_data;
+    io_data.current = adc_current[0];
+    sample_queue.push(io_data);
+}
+
+static volatile uint32_t handoff_sink;
+
+// ns per sample
+static float handoff_time(bool blocks, FftMeter *meter)
+{
+    static Io io;
+    uint32_t sum = 0;
+
+    if (meter) meter->reset_state();
+    clock_t start = clock();
+
+    if (!blocks)
+    {
+        for (uint32_t n = 0; n < HANDOFF_BENCHMARK_SAMPLES; n++)
+        {
+            uint32_t offset = (n % (FETCH_PER_TICK * 2)) * CHANNELS;
+            sample_isr({ &dma_buf[offset], CHANNELS }, { &dma_buf[offset + 1], CHANNELS });
+
+            io_data_t io_data;
+            while (sample_queue.pop(io_data))
+            {
+                if (meter) meter->consume(io_data);
+                else sum += io_data.current;
+            }
+        }
+    }
+    else
+    {
+        for (uint32_t n = 0; n < HANDOFF_BENCHMARK_SAMPLES / IO_BLOCK_SIZE; n++)
+        {
+            dma_half_done(io, n & 1);
+
+            io_block_t block;
+            while (io.out.pop(block))
+            {
+                if (meter) meter->consume(block);
+                else for (uint32_t i = 0; i < IO_BLOCK_SIZE; i++) sum += block.current[i];
+            }
+        }
+    }
+
+    handoff_sink = sum;
+    return (float)(clock() - start) / CLOCKS_PER_SEC * 1e9f / HANDOFF_BENCHMARK_SAMPLES;
+}
+
+void test_handoff_benchmark() {
+    static FftMeter meter;
+
+    dma_fill(0, 2000, 0);
+    dma_fill(1, 2100, 0);
+
+    printf("Handoff, ns per sample: per sample %.1f, per block of %u %.1f\n",
+        handoff_time(false, nullptr), IO_BLOCK_SIZE, handoff_time(true, nullptr));
+    printf("Handoff + meter consume, ns per sample: per sample %.1f, per block of %u %.1f\n",
+        handoff_time(false, &meter), IO_BLOCK_SIZE, handoff_time(true, &meter));
+}
+
+//
+// ADC profiles, simulated by host HAL. Oversampled stream should give the
+// same sample rate for meter, and noise / sqrt(conversions per sample).
+//
+
+#define PROFILE_TONE_HZ 1000.0f
+#define PROFILE_NOISE 40
+
+static uint32_t profile_seed;
+static float profile_tone;
+
+static uint16_t profile_source(uint32_t conversion, uint8_t channel)
+{
+    profile_seed = profile_seed * 1664525 + 1013904223;
+    int32_t noise = (int32_t)((profile_seed >> 16) % (2 * PROFILE_NOISE + 1)) - PROFILE_NOISE;
+
+    float t = (float)conversion / (SAMPLING_RATE * ADC_OVERSAMPLE * ADC_HW_OVERSAMPLE);
+    float tone = channel != ADC_CURRENT_RANK ? 0 : profile_tone * sinf(2 * M_PI * PROFILE_TONE_HZ * t);
+
+    return (uint16_t)(2000 + noise + tone);
+}
+
+// Simulate ADC for 1s, feed io output to meter. Returns number of samples.
+static uint32_t profile_run(FftMeter &meter, float &sum, float &sum2, uint32_t &estimates)
+{
+    static Io io;
+
+    hal::setup();
+    meter.reset_state();
+    meter.tracker_enabled = false;
+    meter.pll_enabled = false;
+    profile_seed = 1;
+
+    uint32_t samples = 0;
+    sum = sum2 = 0;
+    estimates = 0;
+
+    for (uint32_t n = 0; n < SAMPLING_RATE / IO_BLOCK_SIZE; n++)
+    {
+        hal::adc_simulate_half(io, profile_source);
+
+        io_block_t block;
+        while (io.out.pop(block))
+        {
+            meter.consume(block);
+
+            for (uint32_t i = 0; i < IO_BLOCK_SIZE; i++)
+            {
+                float val = (float)block.current[i] - 2000;
+                sum += val;
+                sum2 += val * val;
+            }
+
+            samples += IO_BLOCK_SIZE;
+        }
+
+        while (meter.tick())
+        {
+            if (!meter.frequency) continue;
+
+            estimates++;
+            TEST_ASSERT_FLOAT_WITHIN(1.0f, PROFILE_TONE_HZ, fix16_to_float(meter.frequency));
+        }
+    }
+
+    return samples;
+}
+
+void test_adc_profile() {
+    static FftMeter meter;
+    float sum, sum2;
+    uint32_t estimates;
+
+    // Noise only
+    profile_tone = 0;
+    uint32_t samples = profile_run(meter, sum, sum2, estimates);
+
+    float mean = sum / samples;
+    float sigma = sqrtf(sum2 / samples - mean * mean);
+    // Uniform noise, averaged
+    float expected = PROFILE_NOISE / sqrtf(3.0f * ADC_OVERSAMPLE * ADC_HW_OVERSAMPLE);
+
+    TEST_ASSERT_EQUAL_UINT32(SAMPLING_RATE / IO_BLOCK_SIZE * IO_BLOCK_SIZE, samples);
+    TEST_ASSERT_FLOAT_WITHIN(expected * 0.2f, expected, sigma);
+
+    // Tone is found at the right frequency => sample rate is the same
+    profile_tone = 500;
+    profile_run(meter, sum, sum2, estimates);
+
+    printf("ADC profile %u: %u conversions per sample, %u samples, noise %.1f (expected %.1f), %u estimates\n",
+        ADC_PROFILE, ADC_OVERSAMPLE * ADC_HW_OVERSAMPLE, samples, sigma, expected, estimates);
+
+    TEST_ASSERT_GREATER_THAN(SAMPLING_RATE / FftMeter::HOP_SIZE / 2, estimates);
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_strided_view);
+    RUN_TEST(test_consume_halves);
+    RUN_TEST(test_consume_overflow);
+    RUN_TEST(test_knob_task);
+    RUN_TEST(test_adc_profile);
+    RUN_TEST(test_handoff_benchmark);
+    return UNITY_END();
+}
+
+#endif
@@ -0,0 +1,1807 @@
+#ifdef UNIT_TEST
+
+#include <unity.h>
+
+#include <stdio.h>
+#include <math.h>
+#include <time.h>
+
+#include "meter.h"
+#include "peak_interpolation.h"
+
+// Recordings from doc/data, 15625 Hz (the same as native SAMPLING_RATE).
+#define RECORD_MAX_LENGTH 200000
+
+static uint16_t record[RECORD_MAX_LENGTH];
+static uint32_t record_length;
+
+// Load recording & convert to 12 bits ADC scale. Records have
+// negative values at high speed, so shift those up a bit.
+#define RECORD_OFFSET 8192
+static bool load_record(const char *name)
+{
+    char path[128];
+    snprintf(path, sizeof(path), "doc/data/%s.txt", name);
+
+    FILE *f = fopen(path, "r");
+    if (!f) return false;
+
+    int32_t val;
+    record_length = 0;
+
+    while (record_length < RECORD_MAX_LENGTH && fscanf(f, "%d", &val) == 1)
+    {
+        val += RECORD_OFFSET;
+        if (val < 0) val = 0;
+        if (val > 65535) val = 65535;
+        record[record_length++] = (uint16_t)(val >> 4);
+    }
+
+    fclose(f);
+    return true;
+}
+
+// Feed sample and do one estimation step, like main loop does
+template <typename M>
+static bool feed(M &meter, io_data_t &io_data)
+{
+    meter.consume(io_data);
+    return meter.tick();
+}
+
+// Mains filter needs some time to converge after reset, meter reports
+// zero speed until then.
+template <typename M>
+static bool warming_up(const M &meter)
+{
+    return meter.mains_filter_enabled && !meter.mains_filter.settled;
+}
+
+// Replay recording and check every estimate is within tolerance.
+// Returns number of estimates.
+static uint32_t replay_and_check(const char *name, uint32_t expected_freq, uint32_t tolerance, bool tracker)
+{
+    if (!load_record(name)) TEST_IGNORE_MESSAGE("doc/data recordings not found");
+
+    FftMeter meter;
+    meter.reset_state();
+    meter.tracker_enabled = tracker;
+    meter.pll_enabled = false;
+
+    uint32_t updates = 0;
+    uint32_t misses = 0;
+
+    for (uint32_t i = 0; i < record_length; i++)
+    {
+        io_data_t io_data;
+        io_data.current = record[i];
+
+        if (feed(meter, io_data) && !warming_up(meter))
+        {
+            updates++;
+            float diff = fix16_to_float(meter.frequency) - expected_freq;
+            if (fabsf(diff) > tolerance) misses++;
+        }
+    }
+
+    printf(
+        "%s%s: %u updates (%.1f per second), %u out of +/-%u Hz\n",
+        name, tracker ? " (tracker)" : "", updates,
+        updates * (float)SAMPLING_RATE / record_length, misses, tolerance
+    );
+
+    // Allow rare glitches. High speed record has near equal neighbour line,
+    // which wins sometimes. Bigger FFT resolves it as a separate line, and
+    // it wins ~ 2x more often (not trusted, see test_quality).
+    uint32_t glitches = updates / 20 * (FftMeter::SIZE > 512 ? FftMeter::SIZE / 512 : 1);
+    TEST_ASSERT_LESS_OR_EQUAL(glitches, misses);
+
+    return updates;
+}
+
+// 1 bin tolerance (for 512 points). Records speed is not perfectly stable,
+// so bigger FFT should not be checked with smaller tolerance.
+#define TOLERANCE_HZ (SAMPLING_RATE / (FftMeter::SIZE < 512 ? FftMeter::SIZE : 512) + 1)
+
+void test_update_rate() {
+    if (!load_record("hilda_15625Hz_rpm_low")) TEST_IGNORE_MESSAGE("doc/data recordings not found");
+
+    FftMeter meter;
+    meter.reset_state();
+    meter.tracker_enabled = false;
+    meter.pll_enabled = false;
+
+    uint32_t updates = 0;
+
+    for (uint32_t i = 0; i < record_length; i++)
+    {
+        io_data_t io_data;
+        io_data.current = record[i];
+        if (feed(meter, io_data)) updates++;
+    }
+
+    // First estimate after FFT size samples, then every hop size samples.
+    // The last one can be still in progress at the end of record.
+    uint32_t expected = (record_length - FftMeter::SIZE) / FftMeter::HOP_SIZE + 1;
+    TEST_ASSERT_UINT32_WITHIN(1, expected, updates);
+
+    // FFT is split into small steps and finishes well before next hop,
+    // so no samples are skipped.
+    printf("FFT: %u ticks, max %u points per tick\n", meter.fft_ticks, meter.max_tick_work);
+    TEST_ASSERT_LESS_THAN(FftMeter::HOP_SIZE, meter.fft_ticks);
+    TEST_ASSERT_LESS_OR_EQUAL(FftMeter::BUF_SIZE, meter.max_tick_work);
+}
+
+void test_rpm_low() {
+    replay_and_check("hilda_15625Hz_rpm_low", 610, TOLERANCE_HZ, false);
+    replay_and_check("hilda_15625Hz_rpm_low", 610, TOLERANCE_HZ, true);
+}
+
+void test_rpm_middle() {
+    replay_and_check("hilda_15625Hz_rpm_middle", 2120, TOLERANCE_HZ, false);
+    replay_and_check("hilda_15625Hz_rpm_middle", 2120, TOLERANCE_HZ, true);
+}
+
+void test_rpm_high() {
+    replay_and_check("hilda_15625Hz_rpm_high", 3710, TOLERANCE_HZ, false);
+    replay_and_check("hilda_15625Hz_rpm_high", 3710, TOLERANCE_HZ, true);
+}
+
+//
+// Tracker vs FFT on motor start. Both meters eat the same data, tracker
+// estimates are compared with FFT ones, done at about the same time.
+//
+
+static void replay_tracker_vs_fft(const char *name)
+{
+    if (!load_record(name)) TEST_IGNORE_MESSAGE("doc/data recordings not found");
+
+    FftMeter fft_meter;
+    fft_meter.reset_state();
+    fft_meter.tracker_enabled = false;
+    fft_meter.pll_enabled = false;
+
+    FftMeter tracker_meter;
+    tracker_meter.reset_state();
+    tracker_meter.tracker_enabled = true;
+
+    uint32_t fft_valid_at = 0, tracker_valid_at = 0, fft_updated_at = 0;
+    uint32_t fft_updates = 0, tracker_updates = 0, tracked_updates = 0;
+    uint32_t compared = 0, misses = 0;
+
+    for (uint32_t i = 0; i < record_length; i++)
+    {
+        io_data_t io_data;
+        io_data.current = record[i];
+
+        if (feed(fft_meter, io_data))
+        {
+            fft_updates++;
+            fft_updated_at = i;
+            if (!fft_valid_at && fft_meter.frequency) fft_valid_at = i;
+        }
+
+        if (feed(tracker_meter, io_data))
+        {
+            tracker_updates++;
+            if (!tracker_valid_at && tracker_meter.frequency) tracker_valid_at = i;
+
+            if (!tracker_meter.tracking) continue;
+
+            tracked_updates++;
+
+            if (fft_meter.frequency && i - fft_updated_at < METER_TRACKER_HOP)
+            {
+                compared++;
+                float diff = fix16_to_float(tracker_meter.frequency - fft_meter.frequency);
+                if (fabsf(diff) > TOLERANCE_HZ) misses++;
+            }
+        }
+    }
+
+    printf(
+        "%s: valid from %.3fs (FFT) / %.3fs (tracker), "
+        "%.1f / %.1f updates per second, %u tracked, %u of %u differ > %u Hz\n",
+        name, fft_valid_at / (float)SAMPLING_RATE, tracker_valid_at / (float)SAMPLING_RATE,
+        fft_updates * (float)SAMPLING_RATE / record_length,
+        tracker_updates * (float)SAMPLING_RATE / record_length,
+        tracked_updates, misses, compared, TOLERANCE_HZ
+    );
+
+    TEST_ASSERT_EQUAL_UINT32(fft_valid_at, tracker_valid_at);
+    // After motor start, most of estimates should come from tracker
+    TEST_ASSERT_GREATER_THAN((record_length - fft_valid_at) / METER_TRACKER_HOP * 8 / 10, tracked_updates);
+    TEST_ASSERT_LESS_OR_EQUAL(compared / 20, misses);
+}
+
+void test_tracker_zero_to_low() {
+    replay_tracker_vs_fft("hilda_15625Hz_zero_to_low");
+}
+
+void test_tracker_zero_to_middle() {
+    replay_tracker_vs_fft("hilda_15625Hz_zero_to_middle");
+}
+
+//
+// Harmonic check. Replay all records with & without it, and count
+// octave-like jumps between sequential estimates.
+//
+
+static void replay_harmonic_check(const char *name, bool steady)
+{
+    if (!load_record(name)) TEST_IGNORE_MESSAGE("doc/data recordings not found");
+
+    uint32_t jumps[2], harmonic[2];
+    float confidence[2];
+
+    for (uint8_t check = 0; check < 2; check++)
+    {
+        static FftMeter meter;
+        meter.reset_state();
+        meter.tracker_enabled = false;
+        meter.pll_enabled = false;
+        meter.harmonic_check = check;
+
+        float prev = 0, conf_sum = 0;
+        uint32_t updates = 0;
+        jumps[check] = 0;
+        harmonic[check] = 0;
+
+        for (uint32_t i = 0; i < record_length; i++)
+        {
+            io_data_t io_data;
+            io_data.current = record[i];
+
+            if (!feed(meter, io_data)) continue;
+
+            float freq = fix16_to_float(meter.frequency);
+
+            if (freq > 0 && prev > 0 && (freq > prev * 1.4f || freq < prev * 0.7f)) jumps[check]++;
+            if (meter.method == METER_METHOD_HARMONIC) harmonic[check]++;
+            if (freq > 0) { conf_sum += fix16_to_float(meter.confidence); updates++; }
+
+            prev = freq;
+        }
+
+        confidence[check] = updates ? conf_sum / updates : 0;
+    }
+
+    printf(
+        "%s: jumps %u => %u, harmonic corrections %u, avg confidence %.2f\n",
+        name, jumps[0], jumps[1], harmonic[1], confidence[1]
+    );
+
+    TEST_ASSERT_LESS_OR_EQUAL(jumps[0], jumps[1]);
+    TEST_ASSERT_EQUAL_UINT32(0, harmonic[0]);
+    // Records have no octave errors, sub-harmonics should not be picked
+    if (steady) TEST_ASSERT_EQUAL_UINT32(0, harmonic[1]);
+}
+
+void test_harmonic_records() {
+    replay_harmonic_check("hilda_15625Hz_rpm_low", true);
+    replay_harmonic_check("hilda_15625Hz_rpm_middle", true);
+    replay_harmonic_check("hilda_15625Hz_rpm_high", true);
+    replay_harmonic_check("hilda_15625Hz_zero_to_low", false);
+    replay_harmonic_check("hilda_15625Hz_zero_to_middle", false);
+}
+
+//
+// Noise floor & signal detection
+//
+
+// Speed should not drop to zero on steady rotation
+static void replay_noise_floor(const char *name)
+{
+    if (!load_record(name)) TEST_IGNORE_MESSAGE("doc/data recordings not found");
+
+    static FftMeter meter;
+    meter.reset_state();
+    meter.tracker_enabled = false;
+    meter.pll_enabled = false;
+
+    uint32_t updates = 0, drops = 0, min_snr = UINT32_MAX;
+
+    for (uint32_t i = 0; i < record_length; i++)
+    {
+        io_data_t io_data;
+        io_data.current = record[i];
+
+        if (!feed(meter, io_data) || warming_up(meter)) continue;
+
+        updates++;
+
+        if (meter.frequency == 0) drops++;
+        else if (meter.noise.snr(meter.magnitude2) < min_snr) min_snr = meter.noise.snr(meter.magnitude2);
+    }
+
+    printf("%s: noise floor %u, min SNR %u, %u of %u estimates dropped\n",
+        name, meter.noise.level, min_snr, drops, updates);
+
+    TEST_ASSERT_EQUAL_UINT32(0, drops);
+}
+
+// Simple LCG, to get the same noise on all platforms
+static uint32_t noise_seed;
+
+static int32_t noise_sample(int32_t amplitude)
+{
+    noise_seed = noise_seed * 1664525 + 1013904223;
+    return (int32_t)((noise_seed >> 16) % (2 * amplitude + 1)) - amplitude;
+}
+
+// Feed synthetic signal for given time, returns number of estimates
+// with non-zero speed.
+static uint32_t feed_noise(FftMeter &meter, float seconds, int32_t noise, float tone_amplitude)
+{
+    uint32_t valid = 0;
+    uint32_t length = (uint32_t)(seconds * SAMPLING_RATE);
+
+    for (uint32_t i = 0; i < length; i++)
+    {
+        io_data_t io_data;
+        io_data.current = (uint16_t)(2000 + noise_sample(noise)
+            + tone_amplitude * sinf(2 * M_PI * 1000.0f * i / SAMPLING_RATE));
+
+        if (feed(meter, io_data) && meter.frequency) valid++;
+    }
+
+    return valid;
+}
+
+void test_noise_floor() {
+    replay_noise_floor("hilda_15625Hz_rpm_low");
+    replay_noise_floor("hilda_15625Hz_rpm_middle");
+    replay_noise_floor("hilda_15625Hz_rpm_high");
+
+    static FftMeter meter;
+    meter.reset_state();
+    meter.tracker_enabled = false;
+    meter.pll_enabled = false;
+    noise_seed = 1;
+
+    // Noise only => no speed (after short settling)
+    feed_noise(meter, 0.5f, 100, 0);
+    uint32_t false_valid = feed_noise(meter, 5.0f, 100, 0);
+
+    // Tone, 20dB above noise floor
+    uint32_t tone_valid = feed_noise(meter, 1.0f, 100, 100);
+    uint32_t tone_floor = meter.noise.level;
+
+    // Tone off => zero speed
+    uint32_t tail_valid = feed_noise(meter, 0.5f, 100, 0);
+
+    // 4x more noise. Floor should follow it, without false speed for long.
+    uint32_t step_valid = feed_noise(meter, 1.0f, 400, 0);
+    uint32_t step_floor = meter.noise.level;
+    false_valid += feed_noise(meter, 5.0f, 400, 0);
+
+    // Motor stopped (no noise at all)
+    feed_noise(meter, 0.5f, 0, 0);
+    uint32_t stop_valid = feed_noise(meter, 1.0f, 0, 0);
+
+    uint32_t per_second = SAMPLING_RATE / FftMeter::HOP_SIZE;
+
+    printf("Noise: %u false speeds in 10s, tone %u of %u valid (floor %u), "
+        "%u after tone off, %u after 4x noise step (floor %u => %u), %u when stopped\n",
+        false_valid, tone_valid, per_second, tone_floor, tail_valid, step_valid,
+        tone_floor, step_floor, stop_valid);
+
+    TEST_ASSERT_EQUAL_UINT32(0, false_valid);
+    TEST_ASSERT_UINT32_WITHIN(METER_FFT_OVERLAP, per_second, tone_valid);
+    // Both should be ~ 1 FFT window
+    TEST_ASSERT_LESS_OR_EQUAL(METER_FFT_OVERLAP + 1, tail_valid);
+    TEST_ASSERT_LESS_OR_EQUAL(per_second / 3, step_valid);
+    TEST_ASSERT_EQUAL_UINT32(0, stop_valid);
+}
+
+//
+// Mains filter. Ripple is removed before FFT, so low speed is available
+// (below FFT_TRESHOLD_FREQUENCY, used without filter).
+//
+
+static void replay_mains_filter(const char *name)
+{
+    if (!load_record(name)) TEST_IGNORE_MESSAGE("doc/data recordings not found");
+
+    uint32_t valid_at[2], low_updates[2];
+    float first_freq[2];
+    // Peak in the first used bin can be interpolated half bin down
+    float low = FFT_TRESHOLD_FREQUENCY - fix16_to_float(FftMeter::BIN_HZ) / 2;
+
+    for (uint8_t filter = 0; filter < 2; filter++)
+    {
+        static FftMeter meter;
+        meter.mains_filter_enabled = filter;
+        meter.reset_state();
+        meter.tracker_enabled = false;
+        meter.pll_enabled = false;
+
+        valid_at[filter] = 0;
+        low_updates[filter] = 0;
+        first_freq[filter] = 0;
+
+        for (uint32_t i = 0; i < record_length; i++)
+        {
+            io_data_t io_data;
+            io_data.current = record[i];
+
+            if (!feed(meter, io_data) || !meter.frequency) continue;
+
+            float freq = fix16_to_float(meter.frequency);
+
+            if (!valid_at[filter]) { valid_at[filter] = i; first_freq[filter] = freq; }
+            if (freq < low) low_updates[filter]++;
+        }
+    }
+
+    printf(
+        "%s: valid from %.3fs at %.0f Hz without filter, %.3fs at %.0f Hz with filter, "
+        "%u estimates below %.0f Hz\n",
+        name, valid_at[0] / (float)SAMPLING_RATE, first_freq[0],
+        valid_at[1] / (float)SAMPLING_RATE, first_freq[1],
+        low_updates[1], low
+    );
+
+    TEST_ASSERT_LESS_OR_EQUAL(valid_at[0], valid_at[1]);
+    TEST_ASSERT_EQUAL_UINT32(0, low_updates[0]);
+    // Motor starts slow, and filtered meter sees that (without filter,
+    // the first speed is a line above treshold)
+    TEST_ASSERT_LESS_THAN_FLOAT(low, first_freq[1]);
+    TEST_ASSERT_GREATER_THAN(0, low_updates[1]);
+}
+
+// Rectified mains ripple (harmonics of 2x mains) + low speed tone
+static uint16_t mains_sample(float mains, float tone, uint32_t i)
+{
+    float t = (float)i / SAMPLING_RATE;
+    float v = 2000 + 100 * sinf(2 * M_PI * tone * t);
+
+    for (uint8_t k = 1; k <= 4; k++) v += 400 / k * sinf(2 * M_PI * 2 * mains * k * t + k);
+
+    return (uint16_t)(v + noise_sample(20));
+}
+
+void test_mains_filter() {
+    replay_mains_filter("hilda_15625Hz_zero_to_low");
+
+    // 60Hz mains, a bit off nominal, and speed between harmonics
+    static FftMeter meter;
+    meter.mains_filter_enabled = true;
+    meter.reset_state();
+    meter.tracker_enabled = false;
+    meter.pll_enabled = false;
+    noise_seed = 1;
+
+    uint32_t updates = 0, misses = 0;
+    uint32_t length = 3 * SAMPLING_RATE;
+
+    for (uint32_t i = 0; i < length; i++)
+    {
+        io_data_t io_data;
+        io_data.current = mains_sample(60.2f, 330, i);
+
+        // Skip detection & settling time
+        if (!feed(meter, io_data) || i < length / 3) continue;
+
+        updates++;
+        if (fabsf(fix16_to_float(meter.frequency) - 330) > TOLERANCE_HZ) misses++;
+    }
+
+    float ripple = fix16_to_float(meter.mains_filter.ripple_frequency);
+
+    printf("Mains %u Hz (ripple %.2f Hz), %u of %u estimates out of +/-%u Hz\n",
+        meter.mains_filter.mains_frequency, ripple, misses, updates, TOLERANCE_HZ);
+
+    TEST_ASSERT_TRUE(meter.mains_filter.detected);
+    TEST_ASSERT_EQUAL_UINT8(60, meter.mains_filter.mains_frequency);
+    TEST_ASSERT_FLOAT_WITHIN(0.1f, 120.4f, ripple);
+    TEST_ASSERT_EQUAL_UINT32(0, misses);
+}
+
+// 2nd harmonic stronger than fundamental => max bin gives 2x speed
+static uint16_t harmonic_tone_sample(float freq, uint32_t i)
+{
+    float phase = 2 * M_PI * freq * i / SAMPLING_RATE;
+
+    return (uint16_t)(2000
+        + 400 * sinf(phase)
+        + 700 * sinf(2 * phase + 0.3f)
+        + 200 * sinf(3 * phase + 1.1f));
+}
+
+void test_harmonic_octave_error() {
+    uint32_t count = 0, fixed = 0;
+
+    for (float freq = 700.0f; freq < 1900.0f; freq += 37.0f)
+    {
+        static FftMeter meter;
+        meter.reset_state();
+        meter.tracker_enabled = false;
+        meter.pll_enabled = false;
+        // Single FFT window of clean tone, no mains
+        meter.mains_filter_enabled = false;
+
+        for (uint8_t check = 0; check < 2; check++)
+        {
+            meter.reset_state();
+            meter.harmonic_check = check;
+
+            for (uint32_t i = 0; i <= FftMeter::SIZE * 2; i++)
+            {
+                io_data_t io_data;
+                io_data.current = harmonic_tone_sample(freq, i);
+                if (feed(meter, io_data)) break;
+            }
+
+            float ratio = fix16_to_float(meter.frequency) / freq;
+
+            if (!check)
+            {
+                // Without check - octave error
+                TEST_ASSERT_FLOAT_WITHIN(0.05f, 2.0f, ratio);
+            }
+            else
+            {
+                if (fabsf(ratio - 1.0f) < 0.05f && meter.method == METER_METHOD_HARMONIC) fixed++;
+            }
+        }
+
+        count++;
+    }
+
+    printf("Octave errors fixed: %u of %u\n", fixed, count);
+    TEST_ASSERT_EQUAL_UINT32(count, fixed);
+}
+
+//
+// Synthetic tones sweep, to compare sub-bin peak estimators
+//
+
+#define SWEEP_FREQ_START 600.0f
+#define SWEEP_FREQ_END 6000.0f
+#define SWEEP_FREQ_STEP 7.3f
+
+static uint16_t tone_sample(float freq, uint32_t i, uint32_t rate = SAMPLING_RATE)
+{
+    // Tone + DC + some mains ripple
+    return (uint16_t)(2000
+        + 1000 * sinf(2 * M_PI * freq * i / rate + 0.7f)
+        + 200 * sinf(2 * M_PI * 100 * i / rate));
+}
+
+// Enough for 512 points real FFT
+static fft_complex_t sweep_buf[256];
+
+// Returns RMS error (Hz) of real FFT with given size + peak estimator
+static float sweep_rms_error(uint8_t bits, uint8_t method)
+{
+    uint32_t size = 1 << bits;
+    uint32_t skip = FFT_TRESHOLD_FREQUENCY * size / SAMPLING_RATE + 1;
+    float sum2 = 0;
+    uint32_t count = 0;
+
+    for (float freq = SWEEP_FREQ_START; freq < SWEEP_FREQ_END; freq += SWEEP_FREQ_STEP)
+    {
+        for (uint32_t i = 0; i < size / 2; i++)
+        {
+            sweep_buf[i] = {
+                .r = (fft_t)tone_sample(freq, i * 2) << 14,
+                .i = (fft_t)tone_sample(freq, i * 2 + 1) << 14
+            };
+        }
+
+        fft_fftr(sweep_buf, bits - 1);
+
+        uint32_t max = 0, max_idx = 0;
+        for (uint32_t i = skip; i < size / 2 - 1; i++)
+        {
+            uint32_t magn2 = (uint32_t)(((int64_t)sweep_buf[i].r * sweep_buf[i].r) >> 33) +
+                (uint32_t)(((int64_t)sweep_buf[i].i * sweep_buf[i].i) >> 33);
+            if (magn2 > max) { max = magn2; max_idx = i; }
+        }
+
+        fix16_t offset = 0;
+
+        if (method == METER_PEAK_INTERPOLATION_PARABOLIC)
+        {
+            fft_complex_t &p = sweep_buf[max_idx - 1], &n = sweep_buf[max_idx + 1];
+            offset = peak_offset_parabolic(
+                (uint32_t)(((int64_t)p.r * p.r) >> 33) + (uint32_t)(((int64_t)p.i * p.i) >> 33),
+                max,
+                (uint32_t)(((int64_t)n.r * n.r) >> 33) + (uint32_t)(((int64_t)n.i * n.i) >> 33)
+            );
+        }
+        else if (method == METER_PEAK_INTERPOLATION_JACOBSEN)
+        {
+            offset = peak_offset_jacobsen(
+                sweep_buf[max_idx - 1], sweep_buf[max_idx], sweep_buf[max_idx + 1]
+            );
+        }
+
+        float detected = (max_idx + fix16_to_float(offset)) * SAMPLING_RATE / size;
+        sum2 += (detected - freq) * (detected - freq);
+        count++;
+    }
+
+    return sqrtf(sum2 / count);
+}
+
+void test_interpolation_sweep() {
+    const char *names[] = { "none", "parabolic", "jacobsen" };
+    float rms[3][2];
+
+    for (uint8_t method = 0; method < 3; method++)
+    {
+        rms[method][0] = sweep_rms_error(8, method);
+        rms[method][1] = sweep_rms_error(9, method);
+
+        printf("%-10s RMS error: 256 points %6.2f Hz, 512 points %6.2f Hz\n",
+            names[method], rms[method][0], rms[method][1]);
+    }
+
+    // Any interpolation is better than none
+    TEST_ASSERT_LESS_THAN_FLOAT(rms[METER_PEAK_INTERPOLATION_NONE][0], rms[METER_PEAK_INTERPOLATION_PARABOLIC][0]);
+    TEST_ASSERT_LESS_THAN_FLOAT(rms[METER_PEAK_INTERPOLATION_NONE][0], rms[METER_PEAK_INTERPOLATION_JACOBSEN][0]);
+
+    // Jacobsen with 256 points FFT should be better than raw 512 points one
+    TEST_ASSERT_LESS_THAN_FLOAT(rms[METER_PEAK_INTERPOLATION_NONE][1], rms[METER_PEAK_INTERPOLATION_JACOBSEN][0]);
+}
+
+void test_meter_sweep() {
+    float sum2 = 0;
+    uint32_t count = 0;
+
+    for (float freq = SWEEP_FREQ_START; freq < SWEEP_FREQ_END; freq += SWEEP_FREQ_STEP * 10)
+    {
+        FftMeter meter;
+        meter.mains_filter_enabled = false;
+        meter.reset_state();
+        meter.tracker_enabled = false;
+        meter.pll_enabled = false;
+
+        for (uint32_t i = 0; i <= FftMeter::SIZE * 2; i++)
+        {
+            io_data_t io_data;
+            io_data.current = tone_sample(freq, i);
+            if (feed(meter, io_data)) break;
+        }
+
+        float err = fix16_to_float(meter.frequency) - freq;
+        sum2 += err * err;
+        count++;
+    }
+
+    float rms = sqrtf(sum2 / count);
+    printf("Meter RMS error: %.2f Hz\n", rms);
+
+    // Without interpolation, error is uniform in [-0.5..0.5] bin (RMS ~ 0.29)
+#if METER_PEAK_INTERPOLATION == METER_PEAK_INTERPOLATION_NONE
+    TEST_ASSERT_LESS_THAN_FLOAT((float)SAMPLING_RATE / FftMeter::SIZE / 3, rms);
+#else
+    TEST_ASSERT_LESS_THAN_FLOAT((float)SAMPLING_RATE / FftMeter::SIZE / 4, rms);
+#endif
+}
+
+//
+// FFT windows. Leakage of synthetic tone, and the same records replayed
+// with every window side by side.
+//
+
+static const char *window_names[] = { "rectangular", "hann", "blackman" };
+
+// Spectrum of windowed tone (in bins), 512 points
+template <uint8_t WINDOW>
+static void window_spectrum(float bin)
+{
+    typedef WindowTemplate<9, WINDOW> W;
+
+    for (uint32_t i = 0; i < 256; i++)
+    {
+        uint16_t a = 2048 + (int16_t)(2000 * sinf(2 * M_PI * bin * i * 2 / 512));
+        uint16_t b = 2048 + (int16_t)(2000 * sinf(2 * M_PI * bin * (i * 2 + 1) / 512));
+
+        sweep_buf[i] = {
+            .r = (fft_t)(WINDOW == WINDOW_RECTANGULAR ? (uint32_t)a << 14 : W::apply(a, i * 2)),
+            .i = (fft_t)(WINDOW == WINDOW_RECTANGULAR ? (uint32_t)b << 14 : W::apply(b, i * 2 + 1))
+        };
+    }
+
+    fft_fftr(sweep_buf, 8);
+}
+
+// Main lobe width (bins above -30dB for tone at bin center), and max
+// leakage 8+ bins away (dB, for tone between bins - worst case).
+template <uint8_t WINDOW>
+static void window_leakage(float &width, float &leakage)
+{
+    window_spectrum<WINDOW>(40);
+
+    float peak = (float)bin_magnitude2(sweep_buf[40]);
+    width = 0;
+
+    for (uint32_t i = 3; i < 255; i++)
+    {
+        if ((float)bin_magnitude2(sweep_buf[i]) * 1000 >= peak) width++;
+    }
+
+    window_spectrum<WINDOW>(40.5f);
+
+    peak = (float)bin_magnitude2(sweep_buf[40]);
+    float leak = 0;
+
+    for (uint32_t i = 3; i < 255; i++)
+    {
+        float p = (float)bin_magnitude2(sweep_buf[i]);
+        if ((i < 32 || i > 49) && p > leak) leak = p;
+    }
+
+    leakage = 10 * log10f((leak + 1) / peak);
+}
+
+// Replay record with FFT only, count misses and jitter (RMS difference of
+// sequential good estimates). Records speed is not exactly known, so
+// jitter is used for precision.
+template <uint8_t WINDOW>
+static void window_replay(uint32_t expected, bool filter, uint32_t &misses, float &jitter)
+{
+    static MeterTemplate<FFT_SIZE_BITS, SAMPLING_RATE, FFT_SIZE_BITS - 2, WINDOW> meter;
+    meter.mains_filter_enabled = filter;
+    meter.reset_state();
+    meter.tracker_enabled = false;
+    meter.pll_enabled = false;
+
+    float sum2 = 0, prev = 0;
+    uint32_t count = 0;
+    misses = 0;
+
+    for (uint32_t i = 0; i < record_length; i++)
+    {
+        io_data_t io_data;
+        io_data.current = record[i];
+
+        if (!feed(meter, io_data) || warming_up(meter)) continue;
+
+        float freq = fix16_to_float(meter.frequency);
+
+        if (fabsf(freq - expected) > TOLERANCE_HZ) { misses++; prev = 0; continue; }
+
+        if (prev > 0) { sum2 += (freq - prev) * (freq - prev); count++; }
+        prev = freq;
+    }
+
+    jitter = count ? sqrtf(sum2 / count) : 0;
+}
+
+void test_window() {
+    float width[3], leakage[3];
+
+    window_leakage<WINDOW_RECTANGULAR>(width[0], leakage[0]);
+    window_leakage<WINDOW_HANN>(width[1], leakage[1]);
+    window_leakage<WINDOW_BLACKMAN>(width[2], leakage[2]);
+
+    for (uint8_t w = 0; w < 3; w++)
+    {
+        printf("%-12s main lobe %.0f bins, leakage 8+ bins away %.0f dB\n",
+            window_names[w], width[w], leakage[w]);
+    }
+
+    // Wider main lobe, lower side lobes
+    TEST_ASSERT_LESS_THAN_FLOAT(width[1], width[0]);
+    TEST_ASSERT_LESS_THAN_FLOAT(width[2], width[1]);
+    TEST_ASSERT_LESS_THAN_FLOAT(leakage[0] - 20, leakage[1]);
+    TEST_ASSERT_LESS_THAN_FLOAT(leakage[1], leakage[2]);
+
+    const char *records[] = { "hilda_15625Hz_rpm_low", "hilda_15625Hz_rpm_middle", "hilda_15625Hz_rpm_high" };
+    const uint32_t speeds[] = { 610, 2120, 3710 };
+
+    for (uint8_t r = 0; r < 3; r++)
+    {
+        if (!load_record(records[r])) TEST_IGNORE_MESSAGE("doc/data recordings not found");
+
+        for (uint8_t filter = 0; filter < 2; filter++)
+        {
+            uint32_t misses[3];
+            float jitter[3];
+
+            window_replay<WINDOW_RECTANGULAR>(speeds[r], filter, misses[0], jitter[0]);
+            window_replay<WINDOW_HANN>(speeds[r], filter, misses[1], jitter[1]);
+            window_replay<WINDOW_BLACKMAN>(speeds[r], filter, misses[2], jitter[2]);
+
+            printf("%s%s: misses / jitter", records[r], filter ? " (mains filter)" : "");
+            for (uint8_t w = 0; w < 3; w++) printf(", %s %u / %.2f Hz", window_names[w], misses[w], jitter[w]);
+            printf("\n");
+        }
+    }
+}
+
+//
+// Decimation (zoom) modes. Low speed tone with noise, every mode forced.
+//
+
+// Decimated band limit for 2^bits (1/4 of decimated rate)
+#define DECIMATION_BAND(bits) (SAMPLING_RATE >> ((bits) + 2))
+
+static float tone_noise_sample(float freq, uint32_t i)
+{
+    return 2000 + 1000 * sinf(2 * M_PI * freq * i / SAMPLING_RATE) + noise_sample(300);
+}
+
+// Feed tone, returns RMS error of estimates. The first ones (old tone in
+// history) are skipped. Samples are generated into record buffer first, to
+// measure meter CPU time only.
+static float feed_tone(FftMeter &meter, float freq, float seconds, uint32_t &updates, float *time = NULL)
+{
+    uint32_t settle = (FftMeter::SIZE << meter.decimation_bits) + FftMeter::SIZE;
+    float sum2 = 0;
+    uint32_t count = 0;
+    uint32_t length = (uint32_t)(seconds * SAMPLING_RATE);
+
+    for (uint32_t i = 0; i < length; i++) record[i] = (uint16_t)tone_noise_sample(freq, i);
+
+    clock_t start = clock();
+
+    for (uint32_t i = 0; i < length; i++)
+    {
+        io_data_t io_data;
+        io_data.current = record[i];
+
+        if (!feed(meter, io_data) || i < settle) continue;
+
+        float err = fix16_to_float(meter.frequency) - freq;
+        sum2 += err * err;
+        count++;
+    }
+
+    if (time) *time += (float)(clock() - start) / CLOCKS_PER_SEC;
+
+    updates = count;
+    return count ? sqrtf(sum2 / count) : 1e6f;
+}
+
+void test_decimation() {
+    static FftMeter meter;
+    float rms[METER_DECIMATION_MAX_BITS + 1];
+    const float tones[] = { 215, 265, 320, 370, 420, 470 };
+    noise_seed = 1;
+
+    for (uint8_t bits = 0; bits <= METER_DECIMATION_MAX_BITS; bits++)
+    {
+        meter.decimation_enabled = false;
+        meter.tracker_enabled = false;
+        meter.pll_enabled = false;
+        meter.mains_filter_enabled = true;
+        meter.decimation_bits = bits;
+        meter.reset_state();
+
+        float sum2 = 0, time = 0;
+        uint32_t updates = 0;
+        uint8_t seconds = sizeof(tones) / sizeof(tones[0]);
+
+        // Let mains filter settle
+        feed_noise(meter, 0.5f, 300, 0);
+
+        // Speeds in band of the narrowest mode, off mains harmonics
+        for (uint8_t n = 0; n < seconds; n++)
+        {
+            uint32_t count;
+            float err = feed_tone(meter, tones[n], 1.0f, count, &time);
+            sum2 += err * err;
+            updates += count;
+        }
+
+        rms[bits] = sqrtf(sum2 / seconds);
+
+        // CPU of decimator & FFT only, without mains filter
+        uint32_t count;
+        meter.mains_filter_enabled = false;
+        meter.reset_state();
+        time = 0;
+        feed_tone(meter, tones[0], seconds, count, &time);
+
+        printf("Decimation %u: bin %5.2f Hz, RMS error %.3f Hz, %.1f updates/s, %.0f us CPU per second\n",
+            1 << bits, fix16_to_float(meter.bin_hz()), rms[bits],
+            (float)updates / seconds, time * 1000000 / seconds);
+    }
+
+    // Narrower bins => better precision with the same noise
+    TEST_ASSERT_LESS_THAN_FLOAT(rms[0], rms[METER_DECIMATION_MAX_BITS]);
+
+    // Auto selection with hysteresis
+    meter.decimation_enabled = true;
+    meter.mains_filter_enabled = true;
+    meter.reset_state();
+    uint32_t updates;
+    float band = DECIMATION_BAND(METER_DECIMATION_MAX_BITS);
+
+    feed_tone(meter, band * 0.5f, 2.0f, updates);
+    uint8_t low_bits = meter.decimation_bits;
+    // Between zoom in level & band limit - keep mode
+    feed_tone(meter, band * 0.9f, 1.0f, updates);
+    uint8_t keep_bits = meter.decimation_bits;
+    // Out of band
+    feed_tone(meter, band * 1.2f, 1.0f, updates);
+    uint8_t out_bits = meter.decimation_bits;
+    // Back below limit, but not low enough to zoom in
+    feed_tone(meter, band * 0.9f, 1.0f, updates);
+    uint8_t back_bits = meter.decimation_bits;
+    // Motor stopped => full band
+    feed_noise(meter, 1.0f, 100, 0);
+    uint8_t stop_bits = meter.decimation_bits;
+
+    printf("Auto decimation: %u => %u => %u => %u, stopped %u\n",
+        low_bits, keep_bits, out_bits, back_bits, stop_bits);
+
+    TEST_ASSERT_EQUAL_UINT8(METER_DECIMATION_MAX_BITS, low_bits);
+    TEST_ASSERT_EQUAL_UINT8(METER_DECIMATION_MAX_BITS, keep_bits);
+    TEST_ASSERT_EQUAL_UINT8(METER_DECIMATION_MAX_BITS - 1, out_bits);
+    TEST_ASSERT_EQUAL_UINT8(METER_DECIMATION_MAX_BITS - 1, back_bits);
+    TEST_ASSERT_EQUAL_UINT8(0, stop_bits);
+
+    meter.decimation_enabled = METER_DECIMATION;
+    meter.mains_filter_enabled = METER_MAINS_FILTER;
+    meter.decimation_bits = 0;
+}
+
+//
+// Phase locked loop
+//
+
+// Start loop 15 Hz off, on 1 kHz tone in noise (10dB). Returns lock time
+// (seconds, 0 if not locked), and RMS error of frequency in 2nd second.
+template <uint16_t BANDWIDTH>
+static float pll_simulate(float amplitude, float &rms)
+{
+    static PllTrackerTemplate<SAMPLING_RATE, BANDWIDTH> pll;
+    const float freq = 1000;
+    noise_seed = 1;
+
+    pll.start(fix16_from_float(freq + 15));
+
+    uint32_t locked_at = 0, count = 0;
+    float sum2 = 0;
+
+    for (uint32_t i = 0; i < 2 * SAMPLING_RATE; i++)
+    {
+        float v = 2000 + noise_sample(100) + amplitude * sinf(2 * M_PI * freq * (i % SAMPLING_RATE) / SAMPLING_RATE);
+        pll.update((uint16_t)v);
+
+        if (i % METER_PLL_HOP == 0) pll.refresh();
+        if (pll.locked && !locked_at) locked_at = i;
+
+        if (i >= SAMPLING_RATE)
+        {
+            float err = fix16_to_float(pll.frequency()) - freq;
+            sum2 += err * err;
+            count++;
+        }
+    }
+
+    rms = sqrtf(sum2 / count);
+
+    printf(
+        "PLL %2u Hz (Kp %3d, Ki %6d, LPF 2^-%u): lock %.3fs, RMS error %.2f Hz\n",
+        BANDWIDTH, (int)pll.KP, (int)pll.KI, pll.LPF_SHIFT, locked_at / (float)SAMPLING_RATE, rms
+    );
+
+    return pll.locked ? locked_at / (float)SAMPLING_RATE : 0;
+}
+
+// Loop vs FFT on the same record
+static void replay_pll(const char *name)
+{
+    if (!load_record(name)) TEST_IGNORE_MESSAGE("doc/data recordings not found");
+
+    static FftMeter fft_meter, pll_meter;
+    fft_meter.reset_state();
+    fft_meter.tracker_enabled = false;
+    fft_meter.pll_enabled = false;
+    pll_meter.reset_state();
+    pll_meter.tracker_enabled = false;
+    pll_meter.pll_enabled = true;
+
+    uint32_t fft_updates = 0, pll_updates = 0, locked_at = 0, count = 0;
+    float fft_freq = 0, sum2 = 0;
+
+    for (uint32_t i = 0; i < record_length; i++)
+    {
+        io_data_t io_data;
+        io_data.current = record[i];
+
+        if (feed(fft_meter, io_data))
+        {
+            fft_updates++;
+            fft_freq = fix16_to_float(fft_meter.frequency);
+        }
+
+        if (!feed(pll_meter, io_data) || pll_meter.method != METER_METHOD_PLL) continue;
+
+        if (!locked_at) locked_at = i;
+        pll_updates++;
+
+        float diff = fix16_to_float(pll_meter.frequency) - fft_freq;
+        sum2 += diff * diff;
+        count++;
+    }
+
+    float rms = count ? sqrtf(sum2 / count) : 0;
+
+    printf(
+        "%s: PLL locked at %.2fs, %.1f updates per second (FFT %.1f), RMS from FFT %.2f Hz\n",
+        name, locked_at / (float)SAMPLING_RATE, pll_updates * (float)SAMPLING_RATE / record_length,
+        fft_updates * (float)SAMPLING_RATE / record_length, rms
+    );
+
+    // Locked soon after FFT start, and estimates are much more often
+    TEST_ASSERT_GREATER_THAN(0, locked_at);
+    TEST_ASSERT_LESS_THAN(SAMPLING_RATE, locked_at);
+    TEST_ASSERT_GREATER_THAN(fft_updates * 5, pll_updates);
+    TEST_ASSERT_LESS_THAN_FLOAT(fix16_to_float(FftMeter::BIN_HZ) / 2, rms);
+}
+
+void test_pll() {
+    float rms_narrow, rms_default, rms_wide, rms_noise;
+
+    float lock_narrow = pll_simulate<5>(30, rms_narrow);
+    float lock_default = pll_simulate<20>(30, rms_default);
+    float lock_wide = pll_simulate<50>(30, rms_wide);
+
+    // All lock, wider band locks faster and has more jitter
+    TEST_ASSERT_GREATER_THAN_FLOAT(0, lock_narrow);
+    TEST_ASSERT_GREATER_THAN_FLOAT(0, lock_default);
+    TEST_ASSERT_GREATER_THAN_FLOAT(0, lock_wide);
+    TEST_ASSERT_LESS_THAN_FLOAT(lock_narrow, lock_default);
+    TEST_ASSERT_LESS_THAN_FLOAT(rms_default, rms_narrow);
+    TEST_ASSERT_LESS_THAN_FLOAT(rms_wide, rms_default);
+
+    // Noise only => no lock
+    TEST_ASSERT_EQUAL_FLOAT(0, pll_simulate<20>(0, rms_noise));
+
+    replay_pll("hilda_15625Hz_rpm_low");
+    replay_pll("hilda_15625Hz_rpm_middle");
+    replay_pll("hilda_15625Hz_rpm_high");
+}
+
+//
+// Zero crossing engine vs FFT engine
+//
+
+struct EngineStats {
+    uint32_t updates;
+    float found_at;  // First non-zero speed, seconds
+    float mean;      // Average & deviation over the 2nd half of record
+    float deviation;
+    float time;      // CPU time, seconds
+};
+
+template <typename M>
+static EngineStats replay_engine(M &meter, bool filter)
+{
+    meter.mains_filter_enabled = filter;
+    meter.reset_state();
+
+    EngineStats stats = { 0, 0, 0, 0, 0 };
+    uint32_t count = 0;
+    double sum = 0, sum2 = 0;
+
+    clock_t start = clock();
+
+    for (uint32_t i = 0; i < record_length; i++)
+    {
+        io_data_t io_data;
+        io_data.current = record[i];
+
+        if (!feed(meter, io_data)) continue;
+
+        stats.updates++;
+        float f = fix16_to_float(meter.frequency);
+
+        if (f > 0 && stats.found_at == 0) stats.found_at = (float)i / SAMPLING_RATE;
+        if (i < record_length / 2) continue;
+
+        sum += f;
+        sum2 += f * f;
+        count++;
+    }
+
+    stats.time = (float)(clock() - start) / CLOCKS_PER_SEC;
+    stats.mean = count ? (float)(sum / count) : 0;
+    stats.deviation = count ? sqrtf(fmaxf((float)(sum2 / count) - stats.mean * stats.mean, 0)) : 0;
+
+    return stats;
+}
+
+static void print_engine(const char *name, const EngineStats &stats)
+{
+    printf(
+        "  %-14s %5.0f upd/s, found at %.2fs, %7.1f +/- %5.2f Hz, %.0f ns per sample\n",
+        name, stats.updates * (float)SAMPLING_RATE / record_length, stats.found_at,
+        stats.mean, stats.deviation, stats.time * 1e9f / record_length
+    );
+}
+
+static void compare_engines(const char *name, float &zc_time, float &fft_time)
+{
+    if (!load_record(name)) TEST_IGNORE_MESSAGE("doc/data recordings not found");
+
+    static FftMeter fft_meter;
+    static ZeroCrossingMeter zc_meter;
+    fft_meter.tracker_enabled = false;
+    fft_meter.pll_enabled = false;
+
+    EngineStats fft = replay_engine(fft_meter, true);
+    EngineStats zc = replay_engine(zc_meter, true);
+
+    printf("%s:\n", name);
+    print_engine("fft", fft);
+    print_engine("zero crossing", zc);
+
+    // The same speed, with jitter of the same order. Both see drift of
+    // motor speed in record. High speed record has neighbour line, it
+    // pulls zero crossings up by ~ 0.5%.
+    TEST_ASSERT_FLOAT_WITHIN(fft.mean / 100, fft.mean, zc.mean);
+    TEST_ASSERT_LESS_THAN_FLOAT(fft.deviation * 2 + 5, zc.deviation);
+    // Estimate per period, not per FFT hop
+    TEST_ASSERT_GREATER_THAN(fft.updates * 5, zc.updates);
+
+    // Engines only, without mains filter (it's the same for both, and
+    // takes most of zero crossing engine time)
+    fft = replay_engine(fft_meter, false);
+    zc = replay_engine(zc_meter, false);
+    zc_time += zc.time;
+    fft_time += fft.time;
+
+    print_engine("fft (raw)", fft);
+    print_engine("zc (raw)", zc);
+
+    fft_meter.mains_filter_enabled = METER_MAINS_FILTER;
+    zc_meter.mains_filter_enabled = METER_MAINS_FILTER;
+}
+
+void test_zero_crossing() {
+    float zc_time = 0, fft_time = 0;
+
+    compare_engines("hilda_15625Hz_rpm_low", zc_time, fft_time);
+    compare_engines("hilda_15625Hz_rpm_middle", zc_time, fft_time);
+    compare_engines("hilda_15625Hz_rpm_high", zc_time, fft_time);
+
+    printf(
+        "Zero crossing engine: %u bytes RAM (FFT %u), %.1fx less CPU\n",
+        (uint32_t)sizeof(ZeroCrossingMeter), (uint32_t)sizeof(FftMeter), fft_time / zc_time
+    );
+
+    TEST_ASSERT_LESS_THAN_FLOAT(fft_time, zc_time);
+
+    // Noise only => no speed. Tone 10dB above noise is found.
+    static ZeroCrossingMeter meter;
+    uint32_t valid[2] = { 0, 0 };
+    noise_seed = 1;
+
+    for (uint8_t k = 0; k < 2; k++)
+    {
+        meter.reset_state();
+
+        for (uint32_t i = 0; i < 6 * SAMPLING_RATE; i++)
+        {
+            io_data_t io_data;
+            io_data.current = (uint16_t)(2000 + noise_sample(100)
+                + (k ? 30 : 0) * sinf(2 * M_PI * 1000.0f * i / SAMPLING_RATE));
+
+            if (feed(meter, io_data) && meter.frequency) valid[k]++;
+        }
+    }
+
+    printf("Zero crossing on noise: %u false estimates, %u with tone\n", valid[0], valid[1]);
+
+    TEST_ASSERT_EQUAL(0, valid[0]);
+    TEST_ASSERT_GREATER_THAN(1000, valid[1]);
+    TEST_ASSERT_FLOAT_WITHIN(20, 1000, fix16_to_float(meter.frequency));
+}
+
+// 8K RAM - 1K heap & stack - 0.5K for other app data
+#define METER_RAM_BUDGET (8192 - 1024 - 512)
+
+// 1024 points should fit too (see meter.h), whatever size is built. Complex
+// FFT needs 2x workspace, and is not expected to fit.
+#if METER_REAL_FFT
+static_assert(sizeof(MeterTemplate<10, SAMPLING_RATE>) <= METER_RAM_BUDGET, "1024 points meter does not fit RAM budget");
+#endif
+
+//
+// Estimate quality. On records, most estimates should be trusted, and
+// untrusted ones should hold most of misses. Noise should never give
+// trusted speed, and lost samples should be reported.
+//
+
+static void replay_quality(const char *name, uint32_t expected_freq, uint32_t min_trusted_percent)
+{
+    if (!load_record(name)) TEST_IGNORE_MESSAGE("doc/data recordings not found");
+
+    static FftMeter meter;
+    meter.reset_state();
+    meter.tracker_enabled = false;
+    meter.pll_enabled = false;
+
+    uint32_t valid = 0, trusted = 0, misses = 0, trusted_misses = 0, second_rejected = 0;
+    float min_snr = 1e9f, max_second = 0;
+
+    for (uint32_t i = 0; i < record_length; i++)
+    {
+        io_data_t io_data;
+        io_data.current = record[i];
+
+        if (!feed(meter, io_data) || warming_up(meter) || !meter.frequency) continue;
+
+        valid++;
+
+        bool miss = fabsf(fix16_to_float(meter.frequency) - expected_freq) > TOLERANCE_HZ;
+        if (miss) misses++;
+
+        float snr = fix16_to_float(meter.quality.peak_to_noise);
+        float second = fix16_to_float(meter.quality.second_peak);
+        if (snr < min_snr) min_snr = snr;
+        if (second > max_second) max_second = second;
+
+        if (!meter.quality.trusted())
+        {
+            if (meter.quality.second_peak > F16(METER_QUALITY_MAX_SECOND_PEAK)) second_rejected++;
+            continue;
+        }
+
+        trusted++;
+        if (miss) trusted_misses++;
+    }
+
+    printf("%s: %u of %u estimates trusted, misses %u (%u trusted), min SNR %.1f, max second line %.2f\n",
+        name, trusted, valid, misses, trusted_misses, min_snr, max_second);
+
+    // Trusted estimates are never wrong. Records are clean (high SNR, no
+    // lost samples), so only close second line can make estimate untrusted.
+    TEST_ASSERT_EQUAL_UINT32(0, trusted_misses);
+    TEST_ASSERT_EQUAL_UINT32(valid, trusted + second_rejected);
+    TEST_ASSERT_GREATER_OR_EQUAL(valid * min_trusted_percent / 100, trusted);
+}
+
+void test_quality() {
+    // Weak odd mains lines (250..450 Hz) are not notched by mains filter,
+    // and get close to speed line power with narrow 1024 points bins.
+    replay_quality("hilda_15625Hz_rpm_low", 610, FftMeter::SIZE > 512 ? 90 : 95);
+    // Speed drifts 2117..2152 Hz in this record
+    replay_quality("hilda_15625Hz_rpm_middle", 2135, 90);
+    // Real neighbour line ~ 100 Hz above speed, at 0.2..0.95 of its power.
+    // It wins sometimes, so ~ 40% of estimates are not trusted here.
+    replay_quality("hilda_15625Hz_rpm_high", 3710, 45);
+
+    static FftMeter meter;
+    meter.reset_state();
+    meter.tracker_enabled = false;
+    meter.pll_enabled = false;
+    noise_seed = 1;
+
+    // Noise => nothing trusted. Tone => trusted, with clean spectrum.
+    uint32_t noise_trusted = 0;
+    uint32_t tone_trusted = 0;
+    uint32_t length = 3 * SAMPLING_RATE;
+
+    for (uint32_t i = 0; i < 2 * length; i++)
+    {
+        bool tone = i >= length;
+
+        io_data_t io_data;
+        io_data.current = (uint16_t)(2000 + noise_sample(100)
+            + (tone ? 100 * sinf(2 * M_PI * 1000.0f * i / SAMPLING_RATE) : 0));
+
+        if (!feed(meter, io_data) || !meter.quality.trusted()) continue;
+
+        if (tone) tone_trusted++;
+        else noise_trusted++;
+    }
+
+    uint32_t frames = length / FftMeter::HOP_SIZE;
+
+    printf("Quality: %u trusted on noise, %u of %u on tone\n", noise_trusted, tone_trusted, frames);
+
+    TEST_ASSERT_EQUAL_UINT32(0, noise_trusted);
+    TEST_ASSERT_GREATER_THAN(frames * 9 / 10, tone_trusted);
+
+    // Lost samples are reported once, by the next estimate. Frames with
+    // gap inside of window are skipped.
+    uint32_t start = meter.quality.timestamp;
+    uint32_t discarded = meter.discarded_frames;
+    uint32_t reported = 0, estimates = 0;
+
+    for (uint32_t i = 0; i < length; i++)
+    {
+        io_data_t io_data;
+        io_data.current = (uint16_t)(2000 + 100 * sinf(2 * M_PI * 1000.0f * i / SAMPLING_RATE));
+        io_data.dropped = (i == 1000) ? 3 : 0;
+
+        if (!feed(meter, io_data)) continue;
+
+        estimates++;
+        reported += meter.quality.dropped;
+        TEST_ASSERT_TRUE(meter.quality.contiguous);
+    }
+
+    // 3 lost samples are counted by clock too
+    uint32_t span = meter.quality.timestamp - start;
+    discarded = meter.discarded_frames - discarded;
+
+    printf("Quality: %u lost samples reported, timestamps span %u samples in %u estimates, %u frames discarded\n",
+        reported, span, estimates, discarded);
+
+    TEST_ASSERT_EQUAL_UINT32(3, reported);
+    TEST_ASSERT_EQUAL_UINT32(FftMeter::SIZE / FftMeter::HOP_SIZE, discarded);
+    TEST_ASSERT_EQUAL_UINT32((estimates + discarded) * FftMeter::HOP_SIZE + 3, span);
+}
+
+//
+// Predicted band peak search. Reported peak bin should be the same as with
+// full scan: on steady tones, after jumps (band loses peak => full scan),
+// and on speed ramps. In steady state, most bins should be skipped.
+//
+
+struct BandStats {
+    uint32_t estimates;
+    uint32_t wrong;         // Peak bin differs from expected one
+    uint32_t scanned;       // Bins, computed by peak search
+    uint32_t full;          // The same for full scans only
+};
+
+// Feed tone, with frequency changing linearly from f0 to f1. Estimates
+// are checked after `settle` samples (window is filled with new signal).
+// Expected bin is taken at window center, with +/- `tolerance` bins.
+static void band_feed(FftMeter &meter, float f0, float f1, float seconds, uint32_t tolerance, BandStats &stats,
+                      uint32_t settle = FftMeter::SIZE)
+{
+    static float phase = 0;
+    uint32_t length = (uint32_t)(seconds * SAMPLING_RATE);
+    uint32_t full_bins = FftMeter::SIZE / 2 - 1 - meter.skip_points();
+
+    for (uint32_t i = 0; i < length; i++)
+    {
+        float freq = f0 + (f1 - f0) * i / length;
+        phase += 2 * M_PI * freq / SAMPLING_RATE;
+        if (phase > 2 * M_PI) phase -= 2 * M_PI;
+
+        io_data_t io_data;
+        io_data.current = (uint16_t)(2000 + 1000 * sinf(phase) + noise_sample(300));
+
+        if (!feed(meter, io_data) || i < settle || warming_up(meter)) continue;
+
+        float center = f0 + (f1 - f0) * (i - FftMeter::SIZE / 2) / length;
+        int32_t expected = (int32_t)roundf(center * FftMeter::SIZE / SAMPLING_RATE);
+
+        stats.estimates++;
+        stats.scanned += meter.scanned_bins;
+        stats.full += full_bins;
+        if (abs((int32_t)meter.peak_bin - expected) > (int32_t)tolerance) stats.wrong++;
+    }
+}
+
+// Loop & tracker publish estimates between FFT frames, with newer
+// timestamps. Stats are taken on every estimate then, so those show the
+// last FFT frame, weighted by time. That frame can be one hop older, with
+// window still over the previous tone, so checks start one hop later.
+static BandStats band_steady(bool enabled, bool pll = false, bool tracker = false)
+{
+    static FftMeter meter;
+    meter.decimation_enabled = false;
+    meter.reset_state();
+    meter.tracker_enabled = tracker;
+    meter.pll_enabled = pll;
+    meter.band_search_enabled = enabled;
+    noise_seed = 1;
+
+    // Jumps between steady tones, off-bin and at bin center
+    const float tones[] = { 700, 1234.5f, 3700, 2502.9f, 890 };
+    BandStats stats = {};
+
+    uint32_t settle = pll || tracker ? FftMeter::SIZE + FftMeter::HOP_SIZE : FftMeter::SIZE;
+
+    for (float tone : tones) band_feed(meter, tone, tone, 1, 0, stats, settle);
+
+    printf("Band search %-3s%s: %u estimates, %u wrong bins, %.1f%% of bins scanned\n",
+        enabled ? "on" : "off", pll ? " (pll)" : (tracker ? " (tracker)" : ""),
+        stats.estimates, stats.wrong, stats.scanned * 100.0f / stats.full);
+
+    return stats;
+}
+
+void test_band_search() {
+    BandStats full = band_steady(false);
+    BandStats band = band_steady(true);
+
+    TEST_ASSERT_EQUAL_UINT32(0, full.wrong);
+    TEST_ASSERT_EQUAL_UINT32(0, band.wrong);
+    TEST_ASSERT_EQUAL_UINT32(full.estimates, band.estimates);
+    // ~ 80% less bins in steady state
+    TEST_ASSERT_LESS_THAN(band.full / 4, band.scanned);
+
+    // The same, when speed comes from loop or tracker between frames
+    BandStats pll = band_steady(true, true, false);
+    BandStats tracker = band_steady(true, false, true);
+
+    TEST_ASSERT_EQUAL_UINT32(0, pll.wrong);
+    TEST_ASSERT_LESS_THAN(pll.full / 4, pll.scanned);
+    TEST_ASSERT_EQUAL_UINT32(0, tracker.wrong);
+    // Tracker refreshes FFT every 4 windows, full scan after jump is shown
+    // for longer
+    TEST_ASSERT_LESS_THAN(tracker.full / 2, tracker.scanned);
+
+    // Ramps up & down, ~ 2/3 of max expected acceleration. Line moves by
+    // ~ 3 bins over 512 points window, and that grows as size^2 (longer
+    // window, narrower bins), so 1 bin tolerance is scaled the same way.
+    static constexpr uint32_t ramp_tolerance = FftMeter::SIZE <= 512 ? 1 :
+        (FftMeter::SIZE / 512) * (FftMeter::SIZE / 512);
+    static FftMeter meter;
+    meter.decimation_enabled = false;
+    meter.reset_state();
+    meter.tracker_enabled = false;
+    meter.pll_enabled = false;
+    noise_seed = 1;
+
+    BandStats ramp = {};
+    band_feed(meter, 800, 800, 1, 0, ramp);
+    band_feed(meter, 800, 3200, 0.9f, ramp_tolerance, ramp);
+    band_feed(meter, 3200, 800, 0.9f, ramp_tolerance, ramp);
+
+    printf("Band search on ramps: %u estimates, %u wrong bins, %.1f%% of bins scanned\n",
+        ramp.estimates, ramp.wrong, ramp.scanned * 100.0f / ramp.full);
+
+    TEST_ASSERT_EQUAL_UINT32(0, ramp.wrong);
+}
+
+//
+// Magnitude kernels for peak search. On records, approximate ones should
+// pick the same max bin as exact one. Misses are allowed only when 2 top
+// lines are closer than kernel error.
+//
+
+typedef uint32_t (*MagnitudeKernel)(const fft_complex_t &bin);
+
+static const MagnitudeKernel magnitude_kernels[] = {
+    bin_magnitude2, bin_magnitude2_prescaled, bin_magnitude2_alpha_beta
+};
+static const char *magnitude_kernel_names[] = { "exact", "prescaled", "alpha-beta" };
+
+static uint32_t kernel_argmax(MagnitudeKernel kernel, uint32_t from, uint32_t to)
+{
+    uint32_t max = 0, max_idx = 0;
+
+    for (uint32_t i = from; i < to; i++)
+    {
+        uint32_t magn2 = kernel(sweep_buf[i]);
+        if (magn2 > max) { max = magn2; max_idx = i; }
+    }
+
+    return max_idx;
+}
+
+static void replay_magnitude_kernels(const char *name)
+{
+    if (!load_record(name)) TEST_IGNORE_MESSAGE("doc/data recordings not found");
+
+    const uint32_t size = 512;
+    const uint32_t skip = FFT_TRESHOLD_FREQUENCY * size / SAMPLING_RATE + 1;
+    uint32_t frames = 0;
+    uint32_t differ[3] = { 0 };
+
+    for (uint32_t start = 0; start + size <= record_length; start += size / 2)
+    {
+        for (uint32_t i = 0; i < size / 2; i++)
+        {
+            sweep_buf[i] = {
+                .r = (fft_t)record[start + i * 2] << 14,
+                .i = (fft_t)record[start + i * 2 + 1] << 14
+            };
+        }
+
+        fft_fftr(sweep_buf, 8);
+        frames++;
+
+        uint32_t exact_idx = kernel_argmax(bin_magnitude2, skip, size / 2 - 1);
+
+        for (uint8_t k = 1; k < 3; k++)
+        {
+            uint32_t idx = kernel_argmax(magnitude_kernels[k], skip, size / 2 - 1);
+            if (idx == exact_idx) continue;
+
+            differ[k]++;
+
+            // Only near equal lines can swap (alpha-beta error is 6.25%
+            // of magnitude => 13% of power)
+            float exact = (float)bin_magnitude2(sweep_buf[exact_idx]);
+            float other = (float)bin_magnitude2(sweep_buf[idx]);
+            TEST_ASSERT_GREATER_THAN_FLOAT(exact * 0.85f, other);
+        }
+    }
+
+    printf("%s: %u frames, max bin differs: prescaled %u, alpha-beta %u\n",
+        name, frames, differ[1], differ[2]);
+
+    TEST_ASSERT_LESS_OR_EQUAL(frames / 100, differ[1]);
+    TEST_ASSERT_LESS_OR_EQUAL(frames / 20, differ[2]);
+}
+
+#define MAGNITUDE_BENCHMARK_LOOPS 20000
+
+void test_magnitude_kernels() {
+    replay_magnitude_kernels("hilda_15625Hz_rpm_low");
+    replay_magnitude_kernels("hilda_15625Hz_rpm_middle");
+    replay_magnitude_kernels("hilda_15625Hz_rpm_high");
+
+    // Host timing only. On Cortex-M0+ exact kernel calls 64-bit multiply
+    // twice per bin, others use 32-bit MULS.
+    volatile uint32_t sink = 0;
+
+    for (uint8_t k = 0; k < 3; k++)
+    {
+        clock_t start = clock();
+
+        for (uint32_t n = 0; n < MAGNITUDE_BENCHMARK_LOOPS; n++)
+        {
+            uint32_t acc = 0;
+            for (uint32_t i = 0; i < 256; i++) acc += magnitude_kernels[k](sweep_buf[i]);
+            sink += acc;
+        }
+
+        float ns = (float)(clock() - start) / CLOCKS_PER_SEC * 1e9f / (MAGNITUDE_BENCHMARK_LOOPS * 256);
+        printf("Magnitude kernel %-10s: %.2f ns per bin\n", magnitude_kernel_names[k], ns);
+    }
+
+    (void)sink;
+}
+
+//
+// Cepstrum octave check. Harmonic rich tone, where 2nd harmonic dominates
+// and odd ones are weak - harmonic sum is ambiguous there. With cepstrum,
+// estimates should not become worse anywhere, and octave errors should go.
+//
+
+static const float comb_amplitudes[] = { 300, 500, 75, 150, 75, 225, 75, 200 };
+
+static uint16_t comb_tone_sample(float freq, uint32_t i)
+{
+    float phase = 2 * M_PI * freq * i / SAMPLING_RATE;
+    float val = 2000;
+
+    for (uint8_t h = 0; h < 8; h++) val += comb_amplitudes[h] * sinf((h + 1) * (phase + 0.7f));
+
+    return (uint16_t)(val + noise_sample(30));
+}
+
+struct CepstrumStats {
+    uint32_t estimates;
+    uint32_t good;
+    uint32_t runs;
+};
+
+static CepstrumStats cepstrum_sweep_point(float freq, bool cepstrum)
+{
+    static FftMeter meter;
+    meter.mains_filter_enabled = false;
+    meter.reset_state();
+    meter.tracker_enabled = false;
+    meter.pll_enabled = false;
+    meter.cepstrum_enabled = cepstrum;
+    noise_seed = 1;
+
+    CepstrumStats stats = {};
+
+    for (uint32_t i = 0; i < SAMPLING_RATE; i++)
+    {
+        io_data_t io_data;
+        io_data.current = comb_tone_sample(freq, i);
+        if (!feed(meter, io_data)) continue;
+
+        stats.estimates++;
+        if (fabsf(fix16_to_float(meter.frequency) / freq - 1.0f) < 0.05f) stats.good++;
+        if (meter.cepstrum_used) stats.runs++;
+    }
+
+    TEST_ASSERT_LESS_OR_EQUAL(FftMeter::BUF_SIZE, meter.max_tick_work);
+    return stats;
+}
+
+// Misses on record, with or without cepstrum
+static uint32_t cepstrum_replay(const char *name, uint32_t expected_freq, bool cepstrum, uint32_t &runs)
+{
+    FftMeter meter;
+    meter.reset_state();
+    meter.tracker_enabled = false;
+    meter.pll_enabled = false;
+    meter.cepstrum_enabled = cepstrum;
+
+    uint32_t misses = 0;
+
+    for (uint32_t i = 0; i < record_length; i++)
+    {
+        io_data_t io_data;
+        io_data.current = record[i];
+
+        if (feed(meter, io_data) && !warming_up(meter))
+        {
+            if (fabsf(fix16_to_float(meter.frequency) - expected_freq) > TOLERANCE_HZ) misses++;
+            if (meter.cepstrum_used) runs++;
+        }
+    }
+
+    return misses;
+}
+
+void test_cepstrum() {
+    uint32_t points = 0, fixed = 0, runs = 0;
+
+    for (float freq = 600.0f; freq < 900.0f; freq += 17.0f)
+    {
+        CepstrumStats off = cepstrum_sweep_point(freq, false);
+        CepstrumStats on = cepstrum_sweep_point(freq, true);
+
+        // Cepstrum takes a few ticks more, the last estimate can be late
+        TEST_ASSERT_UINT32_WITHIN(1, off.estimates, on.estimates);
+        // Rare neighbour picks are allowed, but nearly all should be good
+        TEST_ASSERT_GREATER_OR_EQUAL(off.good - off.good / 20, on.good);
+        TEST_ASSERT_GREATER_OR_EQUAL(on.estimates - on.estimates / 20, on.good);
+
+        if (on.good > off.good) fixed++;
+        runs += on.runs;
+        points++;
+    }
+
+    printf("Cepstrum: %u of %u comb tones fixed, %u estimates by cepstrum\n", fixed, points, runs);
+    TEST_ASSERT_GREATER_THAN(0, fixed);
+
+    // Records (high speed one has strong harmonics) should not degrade
+    static const struct { const char *name; uint32_t freq; } records[] = {
+        { "hilda_15625Hz_rpm_low", 610 },
+        { "hilda_15625Hz_rpm_middle", 2120 },
+        { "hilda_15625Hz_rpm_high", 3710 }
+    };
+
+    for (auto &r : records)
+    {
+        if (!load_record(r.name)) TEST_IGNORE_MESSAGE("doc/data recordings not found");
+
+        uint32_t record_runs = 0;
+        uint32_t off = cepstrum_replay(r.name, r.freq, false, record_runs);
+        uint32_t on = cepstrum_replay(r.name, r.freq, true, record_runs);
+
+        printf("%s: misses %u without cepstrum, %u with (%u estimates by cepstrum)\n",
+            r.name, off, on, record_runs);
+        TEST_ASSERT_LESS_OR_EQUAL(off, on);
+    }
+}
+
+void test_memory_budget() {
+    uint32_t ring_bytes = FftMeter::SIZE * sizeof(uint16_t);
+    uint32_t workspace_bytes = FftMeter::BUF_SIZE * sizeof(fft_complex_t);
+    // Collecting samples as fft_complex_t would take 8 bytes per sample
+    uint32_t complex_bytes = FftMeter::SIZE * sizeof(fft_complex_t);
+
+    printf(
+        "Meter RAM (%u points): %u bytes total, history %u + workspace %u "
+        "(%u saved vs complex samples buffer)\n",
+        FftMeter::SIZE, (uint32_t)sizeof(FftMeter), ring_bytes, workspace_bytes,
+        complex_bytes - ring_bytes - workspace_bytes
+    );
+
+    TEST_ASSERT_LESS_OR_EQUAL(METER_RAM_BUDGET, sizeof(FftMeter));
+
+#if METER_REAL_FFT
+    if (FftMeter::SIZE != 1024)
+    {
+        printf("Meter RAM (1024 points): %u bytes\n", (uint32_t)sizeof(MeterTemplate<10, SAMPLING_RATE>));
+    }
+    TEST_ASSERT_LESS_OR_EQUAL(METER_RAM_BUDGET, sizeof(MeterTemplate<10, SAMPLING_RATE>));
+#endif
+}
+
+//
+// Different meter configurations, side by side. Note, this test
+// overrides record buffer.
+//
+
+template <typename M, uint32_t RATE>
+static void compare_configuration(const char *name)
+{
+    static M meter;
+
+    // Tone sweep accuracy
+    float sum2 = 0;
+    uint32_t count = 0;
+
+    for (float freq = SWEEP_FREQ_START; freq < SWEEP_FREQ_END; freq += SWEEP_FREQ_STEP * 10)
+    {
+        meter.reset_state();
+        meter.tracker_enabled = false;
+        meter.pll_enabled = false;
+        meter.mains_filter_enabled = false;
+
+        for (uint32_t i = 0; i <= M::SIZE * 2; i++)
+        {
+            io_data_t io_data;
+            io_data.current = tone_sample(freq, i, RATE);
+            if (feed(meter, io_data)) break;
+        }
+
+        float err = fix16_to_float(meter.frequency) - freq;
+        sum2 += err * err;
+        count++;
+    }
+
+    float rms = sqrtf(sum2 / count);
+
+    // CPU time of continuous estimation, per FFT
+    for (uint32_t i = 0; i < RECORD_MAX_LENGTH; i++) record[i] = tone_sample(1234.5f, i, RATE);
+
+    meter.reset_state();
+    meter.tracker_enabled = false;
+    meter.pll_enabled = false;
+    meter.mains_filter_enabled = METER_MAINS_FILTER;
+
+    uint32_t updates = 0;
+    clock_t start = clock();
+
+    for (uint32_t i = 0; i < RECORD_MAX_LENGTH; i++)
+    {
+        io_data_t io_data;
+        io_data.current = record[i];
+        if (feed(meter, io_data)) updates++;
+    }
+
+    float time = (float)(clock() - start) / CLOCKS_PER_SEC;
+
+    printf(
+        "%-24s bin %5.2f Hz, skip %2u bins, RAM %4u bytes, RMS error %.3f Hz, %.1f us per FFT\n",
+        name, fix16_to_float(M::BIN_HZ), meter.skip_points(), (uint32_t)sizeof(M),
+        rms, time * 1000000 / updates
+    );
+
+#if METER_PEAK_INTERPOLATION == METER_PEAK_INTERPOLATION_NONE
+    TEST_ASSERT_LESS_THAN_FLOAT(fix16_to_float(M::BIN_HZ) / 3, rms);
+#else
+    TEST_ASSERT_LESS_THAN_FLOAT(fix16_to_float(M::BIN_HZ) / 4, rms);
+#endif
+}
+
+void test_configurations() {
+    compare_configuration<MeterTemplate<8, SAMPLING_RATE>, SAMPLING_RATE>("256 points");
+    compare_configuration<MeterTemplate<9, SAMPLING_RATE>, SAMPLING_RATE>("512 points");
+    compare_configuration<MeterTemplate<9, SAMPLING_RATE, 10>, SAMPLING_RATE>("512 points, 10 bits sine");
+    compare_configuration<MeterTemplate<10, SAMPLING_RATE>, SAMPLING_RATE>("1024 points");
+    compare_configuration<MeterTemplate<9, 2 * SAMPLING_RATE>, 2 * SAMPLING_RATE>("512 points, 2x rate");
+}
+
+
+void setUp(void) {}
+void tearDown(void) {}
+
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_update_rate);
+    RUN_TEST(test_rpm_low);
+    RUN_TEST(test_rpm_middle);
+    RUN_TEST(test_rpm_high);
+    RUN_TEST(test_tracker_zero_to_low);
+    RUN_TEST(test_tracker_zero_to_middle);
+    RUN_TEST(test_harmonic_records);
+    RUN_TEST(test_noise_floor);
+    RUN_TEST(test_mains_filter);
+    RUN_TEST(test_harmonic_octave_error);
+    RUN_TEST(test_interpolation_sweep);
+    RUN_TEST(test_meter_sweep);
+    RUN_TEST(test_window);
+    RUN_TEST(test_decimation);
+    RUN_TEST(test_zero_crossing);
+    RUN_TEST(test_pll);
+    RUN_TEST(test_quality);
+    RUN_TEST(test_band_search);
+    RUN_TEST(test_magnitude_kernels);
+    RUN_TEST(test_cepstrum);
+    RUN_TEST(test_memory_budget);
+    RUN_TEST(test_configurations);
+    return UNITY_END();
+}
+
+#endif
@@ -0,0 +1,197 @@
+#ifdef UNIT_TEST
+
+#include <unity.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "app_hal.h"
+#include "regulator.h"
+
+// Closed loop simulation: regulator + first order motor + FFT-like meter.
+// Used to compare speed filter with plain "last estimate" path.
+
+// Motor, normalized: w' = (u - w - load) / T, T = 1 / ADRC_BO
+#define MOTOR_T (1.0 / ADRC_BO)
+// Max motor frequency (Hz) for default config
+#define FREQ_MAX (CFG_RPM_MAX_DEFAULT * MOTOR_POLES / 60)
+
+// Meter: estimate per hop (256 samples), delayed by half of 512 window.
+// Noise is as reported by meter variance() for peaks with SNR 12..200.
+#define METER_PERIOD_MS 16
+#define METER_DELAY_MS 16
+#define BIN_HZ (15625.0 / 512)
+
+#define SIM_MS 6000
+#define SETTLE_MS 1000
+#define LOAD_STEP_MS 3000
+#define LOAD 0.1
+
+#define SIM_ADRC_KP 10.0
+#define SIM_ADRC_KOBSERVERS 1.0
+
+struct LoopStats {
+    double estimate_rms;  // Steady state, speed used by ADRC vs real one, Hz
+    double output_rms;    // Steady state, power change per tick (triac jitter)
+    double load_dip;      // Max speed drop after load step, Hz
+};
+
+static double gaussian()
+{
+    // Box-Muller
+    double u1 = (rand() + 1.0) / (RAND_MAX + 2.0);
+    double u2 = (rand() + 1.0) / (RAND_MAX + 2.0);
+    return sqrt(-2 * log(u1)) * cos(2 * M_PI * u2);
+}
+
+static LoopStats simulate(bool filter)
+{
+    static Regulator regulator;
+
+    srand(1);
+
+    regulator.configure();
+    // Typical calibrated values
+    regulator.cfg_adrc_Kp = F16(SIM_ADRC_KP);
+    regulator.cfg_adrc_Kobservers = F16(SIM_ADRC_KOBSERVERS);
+    regulator.adrc_update_observers_parameters();
+
+    regulator.set_speed_filter(filter);
+    regulator.enable();
+    regulator.setpoint = F16(0.5);
+
+    double w = 0;
+    double history[METER_DELAY_MS + 1] = { 0 };
+
+    double estimate_err2 = 0, output_err2 = 0;
+    double before_load = 0, load_dip = 0;
+    uint32_t ticks = 0;
+    fix16_t prev_power = 0;
+
+    for (uint32_t ms = 0; ms < SIM_MS; ms++)
+    {
+        double load = ms >= LOAD_STEP_MS ? LOAD : 0;
+        double u = fix16_to_float(regulator.power_out);
+
+        w += (u - w - load) / MOTOR_T * 0.001;
+
+        double real = w * FREQ_MAX;
+
+        for (int i = METER_DELAY_MS; i > 0; i--) history[i] = history[i - 1];
+        history[0] = real;
+
+        if (ms % METER_PERIOD_MS == 0 && history[METER_DELAY_MS] > 0)
+        {
+            double snr = 12 + 188.0 * rand() / RAND_MAX;
+            double variance = BIN_HZ * BIN_HZ * (1.0 / 64 + 1 / snr);
+            double z = history[METER_DELAY_MS] + gaussian() * sqrt(variance);
+
+            regulator.measure(fix16_from_float(z), fix16_from_float(variance));
+        }
+
+        if (ms == LOAD_STEP_MS - 1) before_load = real;
+        if (ms >= LOAD_STEP_MS && before_load - real > load_dip) load_dip = before_load - real;
+
+        if (ms % (1000 / APP_ADRC_FREQUENCY) == 0)
+        {
+            regulator.tick();
+
+            // Steady state only, skip start & load step reaction
+            if (ms >= SETTLE_MS && (ms < LOAD_STEP_MS || ms >= LOAD_STEP_MS + SETTLE_MS))
+            {
+                double used = fix16_to_float(filter ?
+                    regulator.speed_filter.frequency : regulator.freq_in);
+                double out_diff = fix16_to_float(regulator.power_out - prev_power);
+
+                estimate_err2 += (used - real) * (used - real);
+                output_err2 += out_diff * out_diff;
+                ticks++;
+            }
+            prev_power = regulator.power_out;
+        }
+    }
+
+    LoopStats stats;
+    stats.estimate_rms = sqrt(estimate_err2 / ticks);
+    stats.output_rms = sqrt(output_err2 / ticks);
+    stats.load_dip = load_dip;
+
+    printf("Speed filter %-3s: estimate RMS %.2f Hz, output step RMS %.4f, load step dip %.1f Hz\n",
+        filter ? "on" : "off", stats.estimate_rms, stats.output_rms, stats.load_dip);
+
+    return stats;
+}
+
+void test_speed_filter()
+{
+    LoopStats plain = simulate(false);
+    LoopStats filtered = simulate(true);
+
+    // Filtered speed should be closer to real one, and make power
+    // output smoother, without loosing reaction to load.
+    TEST_ASSERT_LESS_THAN_FLOAT(plain.estimate_rms * 0.8, filtered.estimate_rms);
+    TEST_ASSERT_LESS_THAN_FLOAT(plain.output_rms * 0.8, filtered.output_rms);
+    TEST_ASSERT_LESS_THAN_FLOAT(plain.load_dip * 1.2, filtered.load_dip);
+}
+
+// Meter estimates can stop for seconds (untrusted ones skipped, motor
+// start). Covariance should saturate, and the next measurement should be
+// taken almost as is.
+void test_speed_filter_no_updates()
+{
+    SpeedKalman filter;
+
+    filter.update(F16(1000), F16(10));
+
+    // 10 seconds of regulator ticks
+    for (uint32_t i = 0; i < 10 * APP_ADRC_FREQUENCY; i++)
+    {
+        filter.predict(0, F16(REGULATOR_SPEED_FILTER_Q));
+
+        TEST_ASSERT_TRUE(filter.p00 >= 0 && filter.p00 <= SpeedKalman::MAX_VARIANCE);
+        TEST_ASSERT_TRUE(filter.p11 >= 0 && filter.p11 <= SpeedKalman::MAX_VARIANCE);
+        TEST_ASSERT_TRUE(filter.p01 >= -SpeedKalman::MAX_VARIANCE && filter.p01 <= SpeedKalman::MAX_VARIANCE);
+    }
+
+    filter.update(F16(1100), F16(10));
+
+    TEST_ASSERT_FLOAT_WITHIN(5, 1100, fix16_to_float(filter.frequency));
+}
+
+// Speed filter is not run while off, and starts from measured speed when
+// switched on.
+void test_speed_filter_switch()
+{
+    static Regulator regulator;
+
+    regulator.configure();
+    regulator.set_speed_filter(false);
+    regulator.enable();
+
+    regulator.measure(F16(1000), F16(10));
+    for (int i = 0; i < 10; i++) regulator.tick();
+
+    TEST_ASSERT_EQUAL(0, regulator.speed_filter.frequency);
+    TEST_ASSERT_EQUAL(SpeedKalman::MAX_VARIANCE, regulator.speed_filter.p00);
+
+    regulator.set_speed_filter(true);
+    TEST_ASSERT_EQUAL(F16(1000), regulator.speed_filter.frequency);
+
+    regulator.measure(F16(1010), F16(10));
+    TEST_ASSERT_FLOAT_WITHIN(1, 1010, fix16_to_float(regulator.speed_filter.frequency));
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_speed_filter);
+    RUN_TEST(test_speed_filter_no_updates);
+    RUN_TEST(test_speed_filter_switch);
+    return UNITY_END();
+}
+
+#endif